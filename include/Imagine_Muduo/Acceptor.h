@@ -29,12 +29,18 @@ class Acceptor : public Connection
     // Acceptor写事件的默认回调函数, 会注册给Channel
     void WriteHandler();
 
+    // 线程池过载时直接在dispatcher线程上accept, 监听Channel不能被拒绝
+    void OverloadHandler();
+
     void DefaultReadCallback(Connection* conn) const;
 
     void DefaultWriteCallback(Connection* conn) const;
 
     Connection* CreateMessageConnection(const std::shared_ptr<Channel>& channel) const;
  
+ private:
+    static const int max_accept_num_ = 64;   // 单次唤醒最多accept的连接数
+
  private:
     const Connection* msg_conn_;             // 为新建立的连接提供回调函数模板, 属于Server
 };
@@ -0,0 +1,108 @@
+#ifndef IMAGINE_MUDUO_BASICSERVER_H
+#define IMAGINE_MUDUO_BASICSERVER_H
+
+#include "Server.h"
+#include "Connection.h"
+#include "Buffer.h"
+#include "Channel.h"
+#include "EventLoop.h"
+#include "log_macro.h"
+
+namespace Imagine_Muduo
+{
+
+/*
+-分帧(Codec)与业务处理(Handler)都由模板参数静态指定的Connection:
+    -读事件中每条消息的Decode与OnMessage都是直接调用, 不再经过read_callback_(std::function)及虚函数DefaultReadCallback
+    -每个连接持有各自的Codec与Handler对象(默认构造), 可以在其中保存跨读事件的解析状态
+    -默认处理读缓冲区中所有完整的消息
+*/
+template <typename Codec, typename Handler>
+class BasicConnection : public Connection
+{
+ public:
+    BasicConnection() : Connection()
+    {
+    }
+
+    BasicConnection(Server* server, std::shared_ptr<Channel> channel) : Connection(server, channel)
+    {
+        IsTakeNextMessage(true);
+    }
+
+    ~BasicConnection()
+    {
+    }
+
+    Connection* Create(const std::shared_ptr<Channel>& channel) const
+    {
+        return new BasicConnection(server_, channel);
+    }
+
+    void ReadHandler()
+    {
+        if (!read_buffer_->Read(channel_->Getfd(), loop_->IsEdgeTriggered())) {
+            IMAGINE_MUDUO_LOG("close channel:%d", channel_->Getfd());
+            server_->CloseConnection(GetPeerIp(), GetPeerPort());
+            return;
+        }
+        ResetRecvTime();
+        ProcessRead(codec_, handler_);
+    }
+
+    void WriteHandler()
+    {
+        ProcessWrite();
+    }
+
+    Codec& GetCodec()
+    {
+        return codec_;
+    }
+
+    Handler& GetHandler()
+    {
+        return handler_;
+    }
+
+ private:
+    Codec codec_;
+    Handler handler_;
+};
+
+/*
+-使用BasicConnection<Codec, Handler>与客户端通信的Server, 只需要提供Codec与Handler类型即可启动:
+    -BasicServer<LineCodec, EchoHandler> server("profile.yaml");
+    -server.Start();
+-原有的动态接口(TcpServer + 重写DefaultReadCallback的Connection)对应Connection::DynamicCodec与Connection::DynamicHandler
+*/
+template <typename Codec, typename Handler>
+class BasicServer : public Server
+{
+ public:
+    BasicServer(const std::string& profile_name) : Server(profile_name, new BasicConnection<Codec, Handler>())
+    {
+    }
+
+    BasicServer(const YAML::Node& config) : Server(config, new BasicConnection<Codec, Handler>())
+    {
+    }
+
+    ~BasicServer()
+    {
+    }
+
+    void DefaultReadCallback(Connection* conn)
+    {
+        return;
+    }
+
+    void DefaultWriteCallback(Connection* conn)
+    {
+        return;
+    }
+};
+
+} // namespace Imagine_Muduo
+
+#endif
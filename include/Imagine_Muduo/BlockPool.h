@@ -0,0 +1,78 @@
+#ifndef IMAGINE_MUDUO_BLOCKPOOL_H
+#define IMAGINE_MUDUO_BLOCKPOOL_H
+
+#include <stddef.h>
+#include <vector>
+#include <list>
+#include <atomic>
+#include <mutex>
+
+namespace Imagine_Muduo
+{
+
+/*
+-缓冲区数据块的线程局部对象池:
+    -每个线程(多Reactor模式下即每个EventLoop)各自持有一个空闲链表, 获取与归还都不加锁
+    -空闲数据块超过高水位时归还给系统直到低水位, 线程退出时归还全部空闲数据块
+    -在A线程获取的数据块可以在B线程归还, 此时进入B线程的空闲链表
+-Buffer与ChainBuffer只在有数据时持有数据块, 数据被取空后立即归还
+*/
+class BlockPool
+{
+ public:
+    struct Stats
+    {
+        size_t acquire_num_;                            // 获取数据块的次数
+        size_t release_num_;                            // 归还数据块的次数
+        size_t system_alloc_num_;                       // 向系统申请数据块的次数
+        size_t system_free_num_;                        // 向系统归还数据块的次数
+        size_t cached_num_;                             // 当前空闲链表中的数据块数目
+    };
+
+ public:
+    static const size_t block_size_ = 4096;             // 数据块大小
+
+ public:
+    // 当前线程的对象池
+    static BlockPool* GetInstance();
+
+    // 设置每个线程空闲数据块的高低水位, low_watermark不能大于high_watermark
+    static void SetWatermark(size_t high_watermark, size_t low_watermark);
+
+    // 所有线程对象池的统计之和
+    static Stats GetGlobalStats();
+
+    char* Acquire();
+
+    void Release(char* block);
+
+    Stats GetStats() const;
+
+ private:
+    BlockPool();
+
+    ~BlockPool();
+
+    void Trim(size_t cached_num);
+
+    // 单写者计数器, 只由所属线程修改, 其他线程统计时读取
+    static void Increase(std::atomic<size_t>& counter);
+
+ private:
+    static std::atomic<size_t> high_watermark_;         // 空闲数据块高水位
+    static std::atomic<size_t> low_watermark_;          // 超过高水位时收缩到的低水位
+    static std::mutex pools_lock_;                      // pools_的锁
+    static std::list<BlockPool*> pools_;                // 所有线程的对象池, 用于汇总统计
+
+ private:
+    std::vector<char*> free_blocks_;                    // 空闲数据块
+    std::atomic<size_t> acquire_num_;
+    std::atomic<size_t> release_num_;
+    std::atomic<size_t> system_alloc_num_;
+    std::atomic<size_t> system_free_num_;
+    std::atomic<size_t> cached_num_;
+};
+
+} // namespace Imagine_Muduo
+
+#endif
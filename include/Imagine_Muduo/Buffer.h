@@ -6,6 +6,7 @@
 #include <vector>
 #include <sys/socket.h>
 #include <functional>
+#include <memory>
 #include <unistd.h>
 
 namespace Imagine_Muduo
@@ -14,28 +15,37 @@ namespace Imagine_Muduo
 class Buffer
 {
  public:
-    Buffer(size_t buffer_size = 1000);
+    Buffer();
 
     ~Buffer();
 
-    bool Read(int fd);
+    // 读取fd中的数据, 返回false表示对端关闭或出错; drain为true时一直读到EAGAIN(边沿触发模式), 否则单次唤醒最多读max_read_num_次
+    bool Read(int fd, bool drain = false);
 
     int Write(int fd);
 
     void append(const char *data, size_t len);
 
-    std::string RetrieveAsString(int len);
+    // 取出头部len字节, len超过可读数据长度时抛出异常
+    std::string RetrieveAsString(size_t len);
 
     std::string RetrieveAllString();
 
+    // 共享持有当前存储, 持有期间Buffer不会原地移动或归还这块存储, 需要移动数据时改为迁移到新的存储
+    std::shared_ptr<const char> Pin();
+
     void EnsureWritableBytes(size_t len);
 
     const char* Peek(size_t idx);
 
-    size_t FindFirst(const std::string& target) const;
+    // 从begin_idx开始查找target, 返回相对可读数据起点的位置, 未找到返回GetLen()
+    size_t FindFirst(const std::string& target, size_t begin_idx = 0) const;
 
     const char *GetData() const;
 
+    // 可原地修改的可读数据(如WebSocket去掩码), 只能修改尚未交给回调的数据
+    char *GetMutableData();
+
     size_t GetLen() const;
 
     void Clear();
@@ -43,10 +53,42 @@ class Buffer
     void Clear(size_t begin_idx, size_t end_idx);
 
  private:
-    std::vector<char> buf_;
+    void AllocateStorage(size_t len);
+
+    static void FreeStorage(char* buf, size_t size);
+
+    // 归还存储, Buffer为空时不持有任何内存
+    void ReleaseStorage();
+
+    // 存储是否还被Pin持有
+    bool IsShared() const;
+
+    // 把未读取的数据迁移到大小为size的新存储
+    void Relocate(size_t size);
+
+ private:
+    struct StorageDeleter
+    {
+        explicit StorageDeleter(size_t size) : size_(size) {}
+
+        void operator()(char* buf) const
+        {
+            FreeStorage(buf, size_);
+        }
+
+        size_t size_;
+    };
+
+ private:
+    static const int max_read_num_ = 16;                // 非drain模式下单次Read最多的readv次数
+    static const size_t spill_size_ = 64 * 1024;        // 线程局部溢出区大小
+
+ private:
+    char* buf_;
     size_t read_idx_;
     size_t write_idx_;
     size_t total_size_;
+    std::shared_ptr<char> pin_;                         // 存储被Pin后由引用计数持有
 };
 
 } // namespace Imagine_Muduo
@@ -0,0 +1,118 @@
+#ifndef IMAGINE_MUDUO_CHAINBUFFER_H
+#define IMAGINE_MUDUO_CHAINBUFFER_H
+
+#include <sys/types.h>
+#include <stdint.h>
+#include <deque>
+
+namespace Imagine_Muduo
+{
+
+/*
+-由定长数据块组成的链式缓冲区, 用作Connection的写缓冲区:
+    -append只在尾部数据块写满时从BlockPool获取新的数据块, 不会移动已有数据
+    -Write通过sendmsg一次发送多个数据块(gather写), 部分写入时按实际写入的字节数跨数据块推进
+    -文件/管道数据记录插入时的内存数据位置, 之前的内存数据发送完后改用sendfile/splice发送, 之后写入的数据排在其后
+    -MSG_ZEROCOPY发送的数据块在发送完后转入pinned_blocks_, 直到从socket错误队列收到内核的完成通知才归还BlockPool, 析构时仍未完成的数据块不再归还
+*/
+class ChainBuffer
+{
+ public:
+    ChainBuffer();
+
+    ~ChainBuffer();
+
+    void append(const char *data, size_t len);
+
+    // 在已写入的数据之后发送文件fd中[offset, offset + len)的内容, close_fd为true时发送完毕后关闭fd
+    void AppendFile(int fd, off_t offset, size_t len, bool close_fd);
+
+    // 在已写入的数据之后通过splice转发管道pipe_fd中的len字节
+    void AppendPipe(int pipe_fd, size_t len, bool close_fd);
+
+    // 尽量发送所有数据, 返回本次写入的字节数, 内核发送缓冲区已满时提前返回, 出错返回-1; zerocopy为true时内存数据以MSG_ZEROCOPY发送(socket需开启SO_ZEROCOPY)
+    ssize_t Write(int fd, bool zerocopy = false);
+
+    // 上一次Write因管道暂时没有数据而停止时返回该管道fd, 否则返回-1(socket发送缓冲区已满或已发送完)
+    int GetWaitingPipe() const;
+
+    // 读取socket错误队列中的零拷贝完成通知并归还已完成的数据块, 返回读取到的通知数
+    size_t ReapZeroCopy(int fd);
+
+    // 等待内核完成通知的数据块数目
+    size_t GetPinnedBlockNum() const;
+
+    // 丢弃头部len字节内存数据
+    void Retrieve(size_t len);
+
+    // 内存数据长度
+    size_t GetLen() const;
+
+    // 尚未发送的文件/管道数据长度
+    size_t GetFileLen() const;
+
+    // 内存数据与文件/管道数据是否都已发送完毕
+    bool IsEmpty() const;
+
+    size_t GetBlockNum() const;
+
+    void Clear();
+
+ private:
+    struct Block
+    {
+        char* data_;
+        size_t read_idx_;
+        size_t write_idx_;
+        uint32_t zerocopy_seq_;                         // 最近一次包含该数据块的零拷贝发送序号
+        bool zerocopy_;                                 // 是否以MSG_ZEROCOPY发送过
+    };
+
+    struct PinnedBlock
+    {
+        uint32_t seq_;
+        char* data_;
+    };
+
+    struct FileItem
+    {
+        size_t position_;                               // 插入时已写入的内存数据总长度, 该位置之前的数据发送完才轮到该项
+        int fd_;
+        off_t offset_;
+        size_t len_;                                    // 剩余待发送的长度
+        bool is_pipe_;
+        bool close_fd_;
+    };
+
+ private:
+    // 发送一次文件/管道数据, 返回发送的字节数; 管道暂时没有数据时设置waiting_pipe_fd_并返回-1(errno为EAGAIN)
+    ssize_t WriteFile(int fd, FileItem& item);
+
+    // 为刚以MSG_ZEROCOPY发送的头部len字节分配序号并标记所在的数据块
+    void MarkZeroCopy(size_t len);
+
+    bool IsZeroCopyPending(const Block& block) const;
+
+    // 归还数据块, 仍被零拷贝发送引用时转入pinned_blocks_
+    void ReleaseBlock(const Block& block);
+
+ private:
+    static const int max_iov_num_ = 64;                 // 单次writev最多携带的数据块数
+
+ private:
+    std::deque<Block> blocks_;                          // 数据块链表, 头部为最早写入的数据
+    std::deque<FileItem> files_;                        // 等待发送的文件/管道数据
+    size_t len_;                                        // 可读内存数据总长度
+    size_t appended_len_;                               // 累计写入的内存数据长度
+    size_t sent_len_;                                   // 累计发送(丢弃)的内存数据长度
+    size_t file_len_;                                   // 尚未发送的文件/管道数据总长度
+    int waiting_pipe_fd_;                               // 上一次Write等待数据的管道, -1表示没有
+    uint32_t zerocopy_next_seq_;                        // 下一次零拷贝发送的序号(与内核计数一致)
+    uint32_t zerocopy_done_seq_;                        // 该序号之前的零拷贝发送均已完成
+    std::deque<bool> zerocopy_done_;                    // [zerocopy_done_seq_, zerocopy_next_seq_)区间内各次发送是否已完成
+    std::deque<PinnedBlock> pinned_blocks_;             // 已发送完但仍被内核引用的数据块, 按序号递增排列
+};
+
+} // namespace Imagine_Muduo
+
+#endif
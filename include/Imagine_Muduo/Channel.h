@@ -24,7 +24,8 @@ class Channel
    {
       ListenChannel,
       EventChannel,
-      TimerChannel
+      TimerChannel,
+      WakeupChannel
    };
 
  public:
@@ -78,12 +79,22 @@ class Channel
 
     void DefaultTimerfdReadEventHandler();
 
+    void DefaultEventfdReadEventHandler();
+
+    // 线程池过载拒绝该Channel的事件时调用, 未设置overload_handler_时直接在当前线程处理事件
+    void HandleOverload();
+
     Channel* SetReadHandler(EventHandler read_handler);
 
     Channel* SetWriteHandler(EventHandler write_handler);
 
     Channel* SetEventHandler(EventHandler handler);
 
+    Channel* SetOverloadHandler(EventHandler overload_handler);
+
+    // EPOLLERR时先调用, 用于读取socket错误队列(MSG_ZEROCOPY完成通知)
+    Channel* SetCompletionHandler(EventHandler completion_handler);
+
  private:
     void Init();
 
@@ -103,6 +114,8 @@ class Channel
     EventHandler handler_;
     EventHandler read_handler_;
     EventHandler write_handler_;
+    EventHandler overload_handler_;
+    EventHandler completion_handler_;
 };
 
 } // namespace Imagine_Muduo
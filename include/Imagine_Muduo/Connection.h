@@ -2,26 +2,39 @@
 #define IMAGINE_MUDUO_CONNECTION_H
 
 #include "common_typename.h"
+#include "MessageView.h"
+#include "WebSocket.h"
 
 #include <memory>
 #include <string>
+#include <list>
+#include <sys/types.h>
 
 namespace Imagine_Muduo
 {
 
 class Server;
 class Buffer;
+class ChainBuffer;
 class Channel;
 class EventLoop;
+class HttpParser;
+class HttpRequest;
 
 class Connection
 {
+   // 空闲连接检测由所属EventLoop维护idle_it_等字段
+   friend class EventLoop;
+
  public:
    enum class MessageFormat
    {
       None = 0,
       FixedLenth,
-      SpecialEOF
+      SpecialEOF,
+      LengthPrefixed,
+      Http,
+      WebSocket
    };
 
    enum class MessageStatus
@@ -29,7 +42,16 @@ class Connection
       None = 0,
       Complete,
       InComplete,
-      OverComplete
+      OverComplete,
+      Error
+   };
+
+   // LengthPrefixed模式下长度字段的编码
+   enum class LengthField
+   {
+      UInt16 = 0,
+      UInt32,
+      Varint
    };
 
    enum class Event
@@ -58,16 +80,62 @@ class Connection
    // Connection对于写事件的处理函数, 注册给Channel
    virtual void WriteHandler() = 0;
 
+   // 线程池过载拒绝该连接的事件时的处理函数, 注册给Channel, 默认调用overload_callback_写出快速失败响应后关闭连接
+   virtual void OverloadHandler();
+
+   // EPOLLERR时的处理函数, 注册给Channel, 读取MSG_ZEROCOPY完成通知并归还内核不再引用的写缓冲区数据块; 没有读写事件时重新注册事件或关闭出错的连接
+   void CompletionHandler();
+
    // 粘包判断函数
    void PackageCoalescingDetector();
 
+   // 使用SetMessageFormat*设置的消息格式分帧
+   struct DynamicCodec
+   {
+      MessageStatus Decode(Connection* conn)
+      {
+         conn->PackageCoalescingDetector();
+         return conn->msg_status_;
+      }
+   };
+
+   // 调用注册的read_callback_(默认为Server绑定的DefaultReadCallback)
+   struct DynamicHandler
+   {
+      void OnMessage(Connection* conn)
+      {
+         conn->read_callback_(conn);
+      }
+   };
+
    // Connection对于请求的处理函数(TcpConnection的ReaadHandler会调用ProcessRead, 进而调用该函数, 对读取的消息进行处理, 这里可以写具体的业务逻辑)
    virtual void DefaultReadCallback(Connection* conn) const;
 
    virtual void DefaultWriteCallback(Connection* conn) const;
 
+   // 过载时的快速失败响应, 通过AppendData写入的数据会在关闭连接前发送给对端
+   virtual void DefaultOverloadCallback(Connection* conn) const;
+
+   // 写缓冲区中的数据全部发送完毕时调用
+   virtual void DefaultWriteCompleteCallback(Connection* conn) const;
+
+   // 写缓冲区待发送数据达到高水位时调用, 默认暂停读取该连接
+   virtual void DefaultHighWaterMarkCallback(Connection* conn) const;
+
+   // 写缓冲区待发送数据从高水位回落到低水位时调用, 默认恢复读取该连接
+   virtual void DefaultLowWaterMarkCallback(Connection* conn) const;
+
    void ProcessRead();
 
+   /*
+   -按Codec切分消息并交给Handler处理, Codec与Handler都是静态类型, 每条消息的分帧与处理都是可以内联的直接调用
+   -Codec需要提供MessageStatus Decode(Connection* conn): 根据GetData()/GetLen()判断当前消息, 完整时通过SetFrame设置消息范围
+   -Handler需要提供void OnMessage(Connection* conn)
+   -ProcessRead()即使用DynamicCodec(按SetMessageFormat*设置的格式分帧)与DynamicHandler(调用read_callback_)的实例
+   */
+   template <typename Codec, typename Handler>
+   void ProcessRead(Codec& codec, Handler& handler);
+
    void ProcessWrite();
 
    // 使用定长消息
@@ -76,6 +144,27 @@ class Connection
    // 使用特殊分隔符
    Connection* const SetMessageFormatWithSpecialEOF(std::string eof = "\0");
 
+   /*
+   -使用长度前缀: 帧由消息头(header_offset字节的其他字段 + 长度字段)与长度字段给出字节数的消息体组成
+   -big_endian只对定长的长度字段有效, Varint按LEB128(低位在前, 每字节7位)解码
+   -max_frame_len限制整个帧(消息头 + 消息体)的长度, 为0表示不限制, 超出时关闭连接
+   */
+   Connection* const SetMessageFormatWithLengthPrefix(LengthField length_field, bool big_endian = true, size_t header_offset = 0, size_t max_frame_len = 0);
+
+   /*
+   -按HTTP/1.1请求分帧: 请求行、消息头及Content-Length/chunked消息体都收全后才调用读回调, 通过GetHttpRequest获取解析结果
+   -同时开启IsTakeNextMessage以处理流水线请求, 并根据每个请求的版本与Connection消息头调用SetAlive
+   -请求不合法或超出max_header_len/max_body_len(0表示不限制)时关闭连接
+   */
+   Connection* const SetMessageFormatWithHttp(size_t max_header_len = 65536, size_t max_body_len = 0);
+
+   /*
+   -按WebSocket帧分帧(一般在Http模式下完成握手后切换): 完整的Text/Binary消息(包括所有分片)收全并原地去掉掩码后才调用读回调, 通过GetWebSocketMessage获取
+   -控制帧不交给读回调: Ping自动回复Pong, Pong忽略, 收到Close时回复Close(己方已发送过Close时不再回复)并在发送完后关闭连接
+   -同时开启IsTakeNextMessage, 帧不合法或消息超出max_message_len(0表示不限制)时关闭连接
+   */
+   Connection* const SetMessageFormatWithWebSocket(size_t max_message_len = 0);
+
    Connection* const ClearMessageFormat();
 
    int GetSockfd() const;
@@ -98,12 +187,42 @@ class Connection
 
    size_t GetMessageLen() const;
 
+   // 当前消息的视图, 不拷贝数据, 只在读回调期间有效
+   MessageView GetMessage() const;
+
+   // 共享持有当前消息所在的存储, 返回的视图在回调结束后仍然有效
+   MessageView PinMessage();
+
+   // LengthPrefixed模式下当前消息的消息头长度(其他模式为0), 消息体紧随其后
+   size_t GetHeaderLen() const;
+
+   // 去掉消息头后的消息体视图
+   MessageView GetBody() const;
+
+   // Http模式下当前请求的解析结果, 只在读回调期间有效
+   const HttpRequest& GetHttpRequest() const;
+
+   // WebSocket模式下当前消息, 负载指向读缓冲区, 只在读回调期间有效
+   const WebSocketMessage& GetWebSocketMessage() const;
+
    const char* GetData() const;
 
    size_t GetLen() const;
 
    Connection* AppendData(const char* data, size_t len);
 
+   // 在已写入的数据之后通过sendfile发送文件fd中[offset, offset + len)的内容, 由写事件驱动并在EPOLLOUT时续传, close_fd为true时发送完毕后关闭fd
+   Connection* SendFile(int fd, off_t offset, size_t len, bool close_fd = false);
+
+   // 在已写入的数据之后通过splice把管道pipe_fd中的len字节转发给对端, 管道暂时没有数据时等待管道可读后继续, 管道提前结束时停止转发
+   Connection* SendPipe(int pipe_fd, size_t len, bool close_fd = false);
+
+   // 把不带掩码的服务端WebSocket帧(帧头 + 负载)直接写入写缓冲区, fin为false时表示后续还有Continuation分片
+   Connection* SendWebSocketFrame(WebSocketMessage::Opcode opcode, const char* data, size_t len, bool fin = true);
+
+   // 发起WebSocket关闭握手, 收到对端的Close后关闭连接
+   Connection* SendWebSocketClose(uint16_t code = 1000, const std::string& reason = "");
+
    Connection* ClearReadBuffer();
 
    Connection* ClearWriteBuffer();
@@ -114,6 +233,9 @@ class Connection
 
    Connection* SetMessageEndIdx(size_t msg_end_idx);
 
+   // 由Codec调用, 当前消息为[0, msg_end_idx), 整个帧(包括分隔符、填充字符等)为[0, frame_end_idx), header_len为消息头长度
+   Connection* SetFrame(size_t msg_end_idx, size_t frame_end_idx, size_t header_len = 0);
+
    Connection* IsTakeNextMessage(bool get_next_msg);
 
    Connection* IsClearReadBuffer(bool is_clear);
@@ -124,6 +246,22 @@ class Connection
 
    Connection* SetWriteCallback(ConnectionCallback write_callback);
 
+   Connection* SetOverloadCallback(ConnectionCallback overload_callback);
+
+   Connection* SetWriteCompleteCallback(ConnectionCallback write_complete_callback);
+
+   Connection* SetHighWaterMarkCallback(ConnectionCallback high_water_mark_callback);
+
+   Connection* SetLowWaterMarkCallback(ConnectionCallback low_water_mark_callback);
+
+   // 暂停/恢复读取该连接, 在下一次注册事件时生效, 应在写缓冲区还有待发送数据时使用(如高水位回调)
+   Connection* PauseRead();
+
+   Connection* ResumeRead();
+
+   // 写缓冲区中等待发送的数据长度
+   size_t GetPendingWriteLen() const;
+
    Connection* Close();
 
    size_t GetUseCount() const;
@@ -135,14 +273,58 @@ class Connection
 
    Connection* UpdateRevent();
 
+ private:
+   // 待发送数据达到zerocopy_threshold时(首次使用时开启SO_ZEROCOPY)使用MSG_ZEROCOPY发送
+   bool UseZeroCopy();
+
+   // 一条消息处理完后按clear_read_buffer_清理该帧
+   void ClearFrame();
+
+   // 消息帧不合法时关闭连接
+   void CloseInvalidFrame();
+
+   // 所有消息处理完后发送响应或重新注册事件, write_idle表示处理前写缓冲区是否没有未发送完的数据
+   void FinishRead(bool write_idle);
+
+   // 解码LengthPrefixed消息头, 设置header_len_与frame_len_, 数据不足时返回InComplete, 帧不合法时返回Error
+   MessageStatus DecodeLengthPrefix(const char* data, size_t len);
+
+   // 处理WebSocket控制帧(Ping/Pong/Close)
+   void ProcessWebSocketControl(const WebSocketMessage& message);
+
+   // 连接关闭时回收仍在等待完成通知的数据块, 有数据块仍被内核引用时把写缓冲区交给DrainZeroCopy
+   void ReleaseZeroCopyBlocks();
+
+   // 在loop线程上定时读取已关闭连接(dup出的fd)的完成通知, 全部完成或超时后关闭fd并释放写缓冲区
+   static void DrainZeroCopy(EventLoop* loop, std::shared_ptr<ChainBuffer> buffer, int fd, int remain_num);
+
+   // 由EventLoop在本轮就绪事件处理完后调用, 发送推迟的响应(已被写事件发送或连接已关闭时不做任何事)
+   void Flush();
+
+   // 开启/关闭TCP_CORK
+   void SetCork(bool on);
+
+   // 管道暂时没有数据时在所属EventLoop上等待管道可读(期间socket不关注EPOLLOUT), 可读后由PipeHandler继续发送
+   bool WatchPipe(int pipe_fd);
+
+   void PipeHandler();
+
+ private:
+   static const int zerocopy_drain_interval_ms_ = 50;         // 连接关闭后读取零拷贝完成通知的间隔(毫秒)
+   static const int zerocopy_drain_timeout_ms_ = 60000;       // 连接关闭后等待零拷贝完成通知的上限(毫秒), 超时的数据块不再归还BlockPool
+
  protected:
    EventLoop* loop_;
    std::shared_ptr<Channel> channel_;
    Server* server_;
    Buffer* read_buffer_;
-   Buffer* write_buffer_;
+   ChainBuffer* write_buffer_;
    ConnectionCallback read_callback_;
    ConnectionCallback write_callback_;
+   ConnectionCallback overload_callback_;
+   ConnectionCallback write_complete_callback_;
+   ConnectionCallback high_water_mark_callback_;
+   ConnectionCallback low_water_mark_callback_;
 
  private:
    std::string ip_;
@@ -156,13 +338,56 @@ class Connection
    MessageStatus msg_status_;
    size_t msg_begin_idx_;
    size_t msg_end_idx_;
+   size_t frame_end_idx_;                      // 当前帧在read_buffer_中的结束位置(包括分隔符及填充字符), 回调结束后清理到此处
+   size_t searched_len_;                       // SpecialEOF模式下已经确认不包含分隔符的数据长度
+   LengthField length_field_;
+   bool big_endian_;
+   size_t header_offset_;                      // 长度字段之前的消息头字节数
+   size_t max_frame_len_;                      // 帧的最大长度, 0表示不限制
+   size_t header_len_;                         // 当前消息的消息头长度
+   size_t frame_len_;                          // LengthPrefixed模式下已解码的当前帧长度, 0表示尚未解码消息头
+   HttpParser* http_parser_;                   // Http模式下的增量解析器, 第一次使用时创建
+   WebSocketParser* ws_parser_;                // WebSocket模式下的帧解析器, 第一次使用时创建
+   bool ws_close_sent_;                        // 是否已发送WebSocket Close帧
    bool keep_alive_;
    Event next_event_;
    bool get_next_msg_;
    bool clear_read_buffer_;
    bool clear_write_buffer_;
+   bool write_in_progress_;                    // 上一次写只发送了部分数据, 等待EPOLLOUT继续发送
+   bool read_paused_;                          // 是否暂停读取
+   bool above_high_water_mark_;                // 待发送数据是否处于高水位之上
+   bool zerocopy_enabled_;                     // socket是否已开启SO_ZEROCOPY
+   bool zerocopy_unsupported_;                 // 开启SO_ZEROCOPY失败(内核不支持), 不再尝试
+   bool flush_queued_;                         // 是否在所属EventLoop的待发送列表中
+   std::shared_ptr<Channel> pipe_channel_;     // 等待管道可读的一次性Channel(监听dup出的fd), 不等待时为nullptr
+
+   long long active_time_;                     // 最近一次活跃的时间(毫秒), 由EventLoop::TouchConnection更新
+   std::list<Connection*>::iterator idle_it_;  // 在所属EventLoop空闲链表中的位置
+   bool idle_linked_;                          // 是否在空闲链表中
+   bool idle_closed_;                          // 已从空闲链表中摘除并关闭, 之后不再重新加入
 };
 
+template <typename Codec, typename Handler>
+void Connection::ProcessRead(Codec& codec, Handler& handler)
+{
+    bool write_idle = !write_in_progress_;
+    do {
+        msg_status_ = codec.Decode(this);
+        if (msg_status_ == MessageStatus::InComplete) {
+            // 消息不完整时不调用回调, 等待后续数据到达后从上次查找的位置继续
+            break;
+        }
+        if (msg_status_ == MessageStatus::Error) {
+            CloseInvalidFrame();
+            return;
+        }
+        handler.OnMessage(this);
+        ClearFrame();
+    } while (get_next_msg_ && GetLen());
+    FinishRead(write_idle);
+}
+
 } // namespace Imagine_Muduo
 
 #endif
\ No newline at end of file
@@ -4,7 +4,7 @@
 #include "Poller.h"
 
 #include <sys/epoll.h>
-#include <unordered_map>
+#include <stdint.h>
 #include <errno.h>
 
 namespace Imagine_Muduo
@@ -12,10 +12,17 @@ namespace Imagine_Muduo
 
 class EventLoop;
 
+/*
+-epoll_event.data.u64由fd和代数(generation)组成:
+    -通过fd直接索引channels_, 不需要哈希查找
+    -fd被关闭并复用后代数不同, 同一批次中的过期事件会被丢弃
+*/
 class EpollPoller : public Poller
 {
  public:
-    EpollPoller(const EventLoop *loop);
+    EpollPoller(const EventLoop *loop, size_t batch_size = 1024);
+
+    ~EpollPoller();
 
     Poller* poll(int timeoutMs, std::vector<std::shared_ptr<Channel>>& active_channels);
 
@@ -27,14 +34,25 @@ class EpollPoller : public Poller
 
     std::shared_ptr<Channel> FindChannel(int fd) const;
 
+ private:
+    struct ChannelSlot
+    {
+        ChannelSlot() : generation_(0)
+        {
+        }
+
+        std::shared_ptr<Channel> channel_;
+        uint32_t generation_;
+    };
+
  private:
     int epollfd_;
-    int channel_num_;
-    pthread_mutex_t* hashmap_lock_;
-    std::unordered_map<int, std::shared_ptr<Channel>> channels_;
+    mutable pthread_mutex_t channels_lock_;                     // 保护channels_, poll时每批事件只加锁一次
+    std::vector<ChannelSlot> channels_;                         // 以fd为下标的Channel表
+    std::vector<epoll_event> events_;                           // 常驻的epoll_wait事件数组, 大小即单次poll的批大小
     const EventLoop *loop_;
 };
 
 } // namespace Imagine_Muduo
 
-#endif
\ No newline at end of file
+#endif
@@ -12,6 +12,8 @@
 #include <queue>
 #include <memory>
 #include <unordered_map>
+#include <atomic>
+#include <mutex>
 
 namespace Imagine_Muduo
 {
@@ -20,9 +22,26 @@ template <typename T>
 class ThreadPool;
 class Channel;
 class Poller;
+class TimingWheel;
+class Connection;
 
 class EventLoop
 {
+ public:
+   // 多Reactor模式下Acceptor为新连接挑选EventLoop的策略
+   enum class DispatchPolicy
+   {
+      RoundRobin = 0,
+      LeastLoaded
+   };
+
+   // I/O多路复用的后端
+   enum class PollerType
+   {
+      Epoll = 0,
+      IoUring
+   };
+
  public:
    EventLoop();
 
@@ -40,8 +59,46 @@ class EventLoop
 
    void loop();
 
+   // 多Reactor模式下, 主Reactor的GetChannelnum返回所有EventLoop的连接数之和
    int GetChannelnum() const;
 
+   // 整个Server的连接数, 从Reactor上调用时返回其主Reactor的统计
+   int GetTotalChannelnum() const;
+
+   bool IsMultiReactor() const;
+
+   // 连接是否使用边沿触发(EPOLLET)模式注册
+   bool IsEdgeTriggered() const;
+
+   // 连接写缓冲区的高低水位(字节), 高水位为0表示不检测
+   size_t GetHighWaterMark() const;
+
+   size_t GetLowWaterMark() const;
+
+   // 单次待发送数据达到该字节数时使用MSG_ZEROCOPY发送, 为0表示关闭
+   size_t GetZeroCopyThreshold() const;
+
+   // 读事件产生的响应是否推迟到本轮就绪事件全部处理完后统一发送
+   bool IsCoalesceOutput() const;
+
+   // 发送包含文件/管道数据的写缓冲区时是否用TCP_CORK包裹
+   bool IsTcpCork() const;
+
+   // 将连接加入待发送列表, 只能在loop线程上调用
+   EventLoop* QueueFlush(Connection* conn);
+
+   // 为新连接挑选负责其I/O的EventLoop, 单Reactor模式下返回自身
+   EventLoop* GetNextLoop();
+
+   // 当前线程是否为执行loop()的线程
+   bool IsInLoopThread() const;
+
+   // 在loop线程上执行functor, 若当前就是loop线程则立即执行, 否则放入任务队列并唤醒loop
+   void RunInLoop(Functor functor);
+
+   // 将functor放入任务队列, 在loop线程处理完本轮就绪事件后执行
+   void QueueInLoop(Functor functor);
+
    EventLoop* AddListenChannel(const std::string& port);
 
    EventLoop* AddListenChannel(int port);
@@ -52,6 +109,9 @@ class EventLoop
 
    std::shared_ptr<Channel> GetListenChannel() const;
 
+   // 分片监听模式下返回每个从Reactor各自的监听Channel, 否则只有主Reactor的监听Channel
+   std::vector<std::shared_ptr<Channel>> GetListenChannels() const;
+
    int GetMaxchannelnum() const;
 
    EventLoop* AddChannel(std::shared_ptr<Channel> channel);
@@ -68,14 +128,45 @@ class EventLoop
    -delay_表示首次开始执行的延时时间,为0表示从当前开始每interval_时间执行一次
    -interval_表示每次执行的间隔时间,为0表示只执行一次
    -delay_与interval_不能同时为0
+   -定时器由时间轮管理, 可以在任意线程调用, 插入与删除都会转到loop线程上完成, 回调也在loop线程上执行
    */
    long long SetTimer(TimerCallback timer_callback, double interval, double delay = 0.0);
 
    EventLoop* CloseTimer(long long timer_id);
 
-   EventLoop* InsertTimer(Timer *timer);
+   // timerfd到期后在loop线程上推进时间轮并执行到期的定时器
+   void HandleTimers();
+
+   // 刷新连接的最近活跃时间并移动到空闲链表尾部, 未开启空闲超时(idle_timeout_为0)时不做任何事
+   void TouchConnection(Connection* conn);
+
+   // 连接关闭时从空闲链表中摘除, 并标记为已关闭使之后的TouchConnection不再重新加入
+   void RemoveIdleConnection(Connection* conn);
+
+   // 线程池及其过载统计, 多Reactor模式下为nullptr
+   const ThreadPool<std::shared_ptr<Channel>>* GetThreadPool() const;
+
+ private:
+   EventLoop(const EventLoop* main_loop);
+
+   void InitSubLoop(const EventLoop* main_loop);
+
+   void InitPoller();
+
+   void StartSubLoops();
+
+   void Wakeup();
+
+   void DoPendingFunctors();
+
+   // 根据时间轮下一次到期的时刻重新设置timerfd
+   void ResetTimerfd();
+
+   // 由周期定时器调用, 从空闲链表头部依次关闭超时的连接
+   void CloseIdleConnections();
 
-   std::vector<Timer *> GetExpiredTimers(const TimeStamp &now);
+   // 本轮就绪事件处理完后依次发送待发送列表中连接的写缓冲区
+   void FlushPendingConnections();
 
  private:
   // 配置文件字段
@@ -83,19 +174,45 @@ class EventLoop
   size_t max_channel_num_;                                                        // 允许的最大连接数
   size_t port_;                                                                   // 监听端口
   bool singleton_log_mode_;                                                       // 单例日志(目前仅支持单例日志)
+  bool multi_reactor_;                                                            // 是否使用one loop per thread的多Reactor模式
+  size_t loop_num_;                                                               // 多Reactor模式下从Reactor(I/O线程)数目
+  DispatchPolicy dispatch_policy_;                                                // 多Reactor模式下新连接的分发策略
+  bool sharded_accept_;                                                           // 多Reactor模式下每个从Reactor通过SO_REUSEPORT各自监听port_
+  OverloadPolicy overload_policy_;                                                // 线程池任务队列已满时的处理策略
+  PollerType poller_type_;                                                        // I/O多路复用的后端
+  size_t poll_batch_size_;                                                        // epoll_wait单次最多返回的事件数
+  bool edge_triggered_;                                                           // 多Reactor模式下连接使用EPOLLET只注册一次, 不再逐事件EPOLLONESHOT重新注册
+  size_t idle_timeout_;                                                           // 连接空闲超时时间(秒), 为0表示不检测
+  size_t high_water_mark_;                                                        // 连接写缓冲区高水位(字节), 为0表示不检测
+  size_t low_water_mark_;                                                         // 连接写缓冲区低水位(字节)
+  size_t zerocopy_threshold_;                                                     // 启用MSG_ZEROCOPY发送的待发送数据下限(字节), 为0表示关闭
+  bool coalesce_output_;                                                          // 多Reactor模式下每轮事件循环对每个连接只发送一次
+  bool tcp_cork_;                                                                 // 发送文件/管道数据时使用TCP_CORK合并报文
   Logger* logger_;                                                                // 日志对象
 
  private:
    bool quit_;                                                                    // loop退出标识
-   ThreadPool<std::shared_ptr<Channel>> *thread_pool_;                            // 线程池对象
-   int channel_num_;                                                              // 当前连接的客户端数目
-   Poller *epoll_;                                                                // I/O多路复用(epoll)对象
+   ThreadPool<std::shared_ptr<Channel>> *thread_pool_;                            // 线程池对象(多Reactor模式下不使用)
+   std::atomic<int> channel_num_;                                                 // 当前连接的客户端数目
+   const EventLoop* main_loop_;                                                   // 从Reactor所属的主Reactor, 主Reactor为nullptr
+   std::vector<EventLoop*> sub_loops_;                                            // 主Reactor持有的从Reactor
+   pthread_t* sub_loop_threads_;                                                  // 从Reactor的线程
+   std::atomic<size_t> next_loop_idx_;                                            // RoundRobin策略的下一个从Reactor下标
+   pthread_t thread_id_;                                                          // 执行loop()的线程
+   std::atomic<bool> looping_;                                                    // loop()是否已经开始执行
+   Poller *epoll_;                                                                // I/O多路复用(epoll/io_uring)对象
    std::shared_ptr<Channel> listen_channel_;                                      // 负责监听端口的channel
-   pthread_mutex_t timer_lock_;                                                   // 定时器队列的锁
    std::shared_ptr<Channel> timer_channel_;                                       // 负责定时器计时的channel
-   std::priority_queue<Timer *, std::vector<Timer *>, TimerPtrCmp> timers_;       // 定时器队列
-   pthread_mutex_t timer_map_lock_;                                               // 定时器hash_map的锁
-   std::unordered_map<long long, Timer *> timer_map_;                             // 定时器hash_map
+   TimingWheel* timing_wheel_;                                                    // 定时器时间轮, 只在loop线程上访问
+   std::atomic<long long> next_timer_id_;                                         // 下一个定时器id
+   long long armed_expire_;                                                       // timerfd当前设置的到期时刻(毫秒), -1表示未设置
+   std::shared_ptr<Channel> wakeup_channel_;                                      // 负责唤醒loop的eventfd channel
+   std::mutex functor_lock_;                                                      // pending_functors_的锁
+   std::vector<Functor> pending_functors_;                                        // 等待在loop线程上执行的任务
+   std::atomic<bool> calling_pending_functors_;                                   // loop线程是否正在执行pending_functors_
+   std::mutex idle_lock_;                                                         // idle_list_的锁
+   std::list<Connection*> idle_list_;                                             // 空闲连接LRU链表, 按最近活跃时间从旧到新排列
+   std::vector<std::pair<std::shared_ptr<Channel>, Connection*>> pending_flush_;  // 本轮等待发送的连接(持有Channel防止连接被提前销毁), 只在loop线程上访问
 };
 
 } // namespace Imagine_Muduo
@@ -0,0 +1,158 @@
+#ifndef IMAGINE_MUDUO_HTTPPARSER_H
+#define IMAGINE_MUDUO_HTTPPARSER_H
+
+#include "StringView.h"
+#include "MessageView.h"
+
+#include <vector>
+#include <utility>
+
+namespace Imagine_Muduo
+{
+
+class HttpParser;
+
+/*
+-解析完成的HTTP/1.x请求, 所有字段都是指向读缓冲区的视图, 只在读回调期间有效
+*/
+class HttpRequest
+{
+   friend class HttpParser;
+
+ public:
+   HttpRequest();
+
+   StringView GetMethod() const;
+
+   // 请求行中的完整目标(路径及查询字符串)
+   StringView GetTarget() const;
+
+   StringView GetPath() const;
+
+   // '?'之后的查询字符串, 没有时为空
+   StringView GetQuery() const;
+
+   // HTTP/1.x中的x
+   int GetMinorVersion() const;
+
+   size_t GetHeaderNum() const;
+
+   StringView GetHeaderName(size_t idx) const;
+
+   StringView GetHeaderValue(size_t idx) const;
+
+   // 忽略大小写查找第一个同名消息头, 不存在时返回空视图
+   StringView GetHeader(const StringView& name) const;
+
+   bool HasHeader(const StringView& name) const;
+
+   // 消息体, chunked编码时每个数据块为一个内存段(不包括块长度行)
+   const MessageView& GetBody() const;
+
+   bool IsChunked() const;
+
+   // 根据版本与Connection消息头判断是否保持连接
+   bool IsKeepAlive() const;
+
+ private:
+   StringView method_;
+   StringView target_;
+   int minor_version_;
+   std::vector<std::pair<StringView, StringView>> headers_;
+   MessageView body_;
+   bool chunked_;
+   bool keep_alive_;
+};
+
+/*
+-可恢复的增量HTTP/1.1请求解析器:
+    -每次传入从请求起始位置开始的全部已接收数据, 从上次解析到的位置继续, 每个字节只解析一次
+    -解析过程中只记录相对请求起始位置的偏移, 读缓冲区扩容或移动不影响已解析的结果, 请求完整时才生成视图
+    -支持Content-Length与chunked消息体, 同时出现两者或消息头/消息体超出限制时返回Error
+    -请求完整后再次调用Parse即开始解析下一个请求(流水线)
+*/
+class HttpParser
+{
+ public:
+   enum class ParseStatus
+   {
+      InComplete = 0,
+      Complete,
+      Error
+   };
+
+ public:
+   // max_header_len限制请求行与消息头的总长度, max_body_len限制消息体长度(0表示不限制)
+   HttpParser(size_t max_header_len = 65536, size_t max_body_len = 0);
+
+   ParseStatus Parse(const char* data, size_t len);
+
+   // 完整请求(包括消息体及chunked结尾)的长度
+   size_t GetParsedLen() const;
+
+   const HttpRequest& GetRequest() const;
+
+   HttpParser* SetMaxHeaderLen(size_t max_header_len);
+
+   HttpParser* SetMaxBodyLen(size_t max_body_len);
+
+   // 丢弃解析到一半的请求
+   void Reset();
+
+ private:
+   enum class State
+   {
+      RequestLine = 0,
+      Headers,
+      Body,
+      ChunkSize,
+      ChunkData,
+      Trailers,
+      Complete
+   };
+
+   struct Range
+   {
+      size_t begin_;
+      size_t len_;
+   };
+
+ private:
+   // 从begin开始查找CRLF, 返回CR的位置, 不存在时返回len
+   static size_t FindLineEnd(const char* data, size_t begin, size_t len);
+
+   ParseStatus ParseRequestLine(const char* data, size_t line_end);
+
+   ParseStatus ParseHeaderLine(const char* data, size_t line_end);
+
+   // 消息头结束后根据Content-Length/Transfer-Encoding/Connection确定消息体的解析方式
+   ParseStatus ProcessHeaders(const char* data);
+
+   ParseStatus ParseChunkSize(const char* data, size_t line_end);
+
+   // 请求完整时把记录的偏移转换为视图
+   void BuildRequest(const char* data);
+
+ private:
+   static const size_t max_chunk_line_len_ = 1024;   // chunk长度行(包括扩展)的最大长度
+
+ private:
+   size_t max_header_len_;
+   size_t max_body_len_;
+   State state_;
+   size_t parsed_len_;                                // 已解析的长度(相对请求起始位置)
+   Range method_;
+   Range target_;
+   int minor_version_;
+   std::vector<std::pair<Range, Range>> headers_;
+   std::vector<Range> body_;                          // 消息体的各个内存段
+   size_t body_len_;                                  // 已解析的消息体长度
+   size_t remain_len_;                                // 当前Content-Length消息体或chunk数据块的长度
+   bool chunked_;
+   bool keep_alive_;
+   HttpRequest request_;
+};
+
+} // namespace Imagine_Muduo
+
+#endif
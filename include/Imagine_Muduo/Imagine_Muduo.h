@@ -2,5 +2,6 @@
 #define IMAGINE_MUDUO_IMAGINE_MUDUO_H
 
 #include "TcpServer.h"
+#include "BasicServer.h"
 
 #endif
\ No newline at end of file
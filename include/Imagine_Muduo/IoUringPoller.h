@@ -0,0 +1,97 @@
+#ifndef IMAGINE_MUDUO_IOURINGPOLLER_H
+#define IMAGINE_MUDUO_IOURINGPOLLER_H
+
+#include "Poller.h"
+
+#include <linux/io_uring.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <unordered_map>
+
+namespace Imagine_Muduo
+{
+
+class EventLoop;
+
+/*
+-基于io_uring的Poller:
+    -带EPOLLONESHOT的Channel使用单次IORING_OP_POLL_ADD, 其余Channel使用multishot poll
+    -loop线程上的Update只把SQE放入提交队列, 与下一次poll的等待合并为一次io_uring_enter
+    -其它线程上的Update立即提交, 保证loop阻塞时重新注册的事件能够及时生效
+    -user_data由fd和代数(generation)组成, 用于丢弃已被替换的poll请求产生的过期完成事件
+*/
+class IoUringPoller : public Poller
+{
+ public:
+    IoUringPoller(const EventLoop *loop, unsigned entries = 4096);
+
+    ~IoUringPoller();
+
+    Poller* poll(int timeoutMs, std::vector<std::shared_ptr<Channel>>& active_channels);
+
+    Poller* AddChannel(const std::shared_ptr<Channel>& channel);
+
+    Poller* DelChannel(const std::shared_ptr<Channel>& channel);
+
+    const Poller* Update(int fd, int events) const;
+
+    std::shared_ptr<Channel> FindChannel(int fd) const;
+
+    // 当前内核是否支持io_uring(需要EXT_ARG以及multishot poll, 即5.13及以上)
+    static bool IsSupported();
+
+ private:
+    struct PollEntry
+    {
+        std::shared_ptr<Channel> channel_;
+        uint32_t generation_;
+        bool armed_;
+        bool multishot_;
+        int events_;
+    };
+
+ private:
+    // 以下函数均需要在持有ring_lock_时调用, 返回放入提交队列的SQE数目
+    int PrepPollAdd(int fd, PollEntry& entry) const;
+
+    int PrepPollRemove(int fd, const PollEntry& entry) const;
+
+    io_uring_sqe* GetSqe() const;
+
+    void CommitSqe() const;
+
+    // 提交SQE, loop线程上延迟到下一次poll时与等待一起提交
+    void Submit(int sqe_num) const;
+
+    void Enter(unsigned to_submit, unsigned min_complete, unsigned flags) const;
+
+ private:
+    int ring_fd_;
+    const EventLoop *loop_;
+    mutable pthread_mutex_t ring_lock_;                                  // 保护SQ以及channels_
+    mutable std::unordered_map<int, PollEntry> channels_;
+    mutable unsigned pending_submit_;                                    // loop线程上已放入SQ但尚未提交的SQE数目
+    mutable uint32_t next_generation_;                                   // 所有poll请求共用的代数计数, 不随fd复用而重置
+
+    // SQ
+    void* sq_ring_ptr_;
+    size_t sq_ring_size_;
+    unsigned* sq_head_;
+    unsigned* sq_tail_;
+    unsigned sq_mask_;
+    unsigned sq_entries_;
+    io_uring_sqe* sqes_;
+    size_t sqes_size_;
+
+    // CQ
+    void* cq_ring_ptr_;
+    size_t cq_ring_size_;
+    unsigned* cq_head_;
+    unsigned* cq_tail_;
+    unsigned cq_mask_;
+    io_uring_cqe* cqes_;
+};
+
+} // namespace Imagine_Muduo
+
+#endif
@@ -0,0 +1,85 @@
+#ifndef IMAGINE_MUDUO_MESSAGEVIEW_H
+#define IMAGINE_MUDUO_MESSAGEVIEW_H
+
+#include <stddef.h>
+#include <string>
+#include <vector>
+#include <memory>
+
+namespace Imagine_Muduo
+{
+
+/*
+-不拷贝数据的消息视图, 由一个或多个连续内存段组成:
+    -默认只在读回调期间有效, 回调返回后数据所在的缓冲区可能被清理或复用
+    -Connection::PinMessage返回的视图共享持有数据所在的存储, 可以在回调结束后继续使用
+*/
+class MessageView
+{
+ public:
+    struct Segment
+    {
+        const char* data_;
+        size_t len_;
+    };
+
+    class SegmentIterator
+    {
+     public:
+        SegmentIterator(const MessageView* view, size_t idx);
+
+        const Segment& operator*() const;
+
+        const Segment* operator->() const;
+
+        SegmentIterator& operator++();
+
+        bool operator==(const SegmentIterator& other) const;
+
+        bool operator!=(const SegmentIterator& other) const;
+
+     private:
+        const MessageView* view_;
+        size_t idx_;
+    };
+
+ public:
+    MessageView();
+
+    MessageView(const char* data, size_t len, std::shared_ptr<const char> pin = nullptr);
+
+    // 在末尾追加一个内存段
+    MessageView* AppendSegment(const char* data, size_t len, std::shared_ptr<const char> pin = nullptr);
+
+    // 第一个内存段的起始地址, 只有一个内存段时即为整个消息
+    const char* GetData() const;
+
+    // 消息总长度
+    size_t GetLen() const;
+
+    size_t GetSegmentNum() const;
+
+    bool IsContiguous() const;
+
+    bool IsPinned() const;
+
+    SegmentIterator begin() const;
+
+    SegmentIterator end() const;
+
+    // 拷贝整个消息, 仅在确实需要std::string时使用
+    std::string ToString() const;
+
+ private:
+    const Segment& GetSegment(size_t idx) const;
+
+ private:
+    Segment first_;                                     // 第一个内存段, 大多数消息只有这一段, 不需要额外分配内存
+    std::vector<Segment> segments_;                     // 其余的内存段
+    size_t len_;                                        // 所有内存段的总长度
+    std::vector<std::shared_ptr<const char>> pins_;     // 共享持有的存储
+};
+
+} // namespace Imagine_Muduo
+
+#endif
@@ -9,6 +9,7 @@
 #include "yaml-cpp/yaml.h"
 
 #include <unordered_map>
+#include <vector>
 
 namespace Imagine_Muduo
 {
@@ -44,6 +45,12 @@ class Server
 
    Server* const SetWriteCallback(Connection* new_conn);
 
+   Server* const SetOverloadCallback(Connection* new_conn);
+
+   Server* const SetWriteCompleteCallback(Connection* new_conn);
+
+   Server* const SetWaterMarkCallback(Connection* new_conn);
+
    Connection* GetMessageConnection() const;
 
    void DestroyConnection();
@@ -56,11 +63,16 @@ class Server
  private:
    EventLoop* loop_;                                                                                          // Loop对象
    Connection* acceptor_;                                                                                     // 接收连接的Connection对象(对应监听端口的Channel)
+   std::vector<Connection*> shard_acceptors_;                                                                 // 分片监听模式下其余监听Channel对应的Acceptor
    Connection* msg_conn_;                                                                                     // 与客户端通信的Connection对象(提供模板)
    std::unordered_map<std::pair<std::string, std::string>, Connection*, HashPair, EqualPair> conn_map_;       // 所有已经建立连接的Connection对象集合
    std::mutex map_lock_;                                                                                      // conn_map_的锁
    ConnectionCallback read_callback_;                                                                         // 请求业务处理处理函数, 由msg_conn_决定 
    ConnectionCallback write_callback_;                                                                        // 写请求业务处理函数, 由msg_conn_决定
+   ConnectionCallback overload_callback_;                                                                     // 过载时的快速失败处理函数, 由msg_conn_决定
+   ConnectionCallback write_complete_callback_;                                                               // 写缓冲区发送完毕的处理函数, 由msg_conn_决定
+   ConnectionCallback high_water_mark_callback_;                                                              // 写缓冲区达到高水位的处理函数, 由msg_conn_决定
+   ConnectionCallback low_water_mark_callback_;                                                               // 写缓冲区回落到低水位的处理函数, 由msg_conn_决定
    std::list<Connection*> close_list_;                                                                        // 连接关闭队列
    pthread_t *destroy_thread_;                                                                                // 连接关闭线程
    pthread_mutex_t destroy_lock_;                                                                             // 连接关闭队列的锁
@@ -0,0 +1,49 @@
+#ifndef IMAGINE_MUDUO_SIMDSEARCH_H
+#define IMAGINE_MUDUO_SIMDSEARCH_H
+
+#include <stddef.h>
+
+namespace Imagine_Muduo
+{
+
+/*
+-消息分帧用的字节查找:
+    -x86下根据CPU在运行时选择AVX2/SSE2实现, 其他平台及不足一个向量的尾部使用标量实现
+    -多字节分隔符先用向量同时比较首尾两个字节筛选候选位置, 再用memcmp确认
+*/
+class SimdSearch
+{
+ public:
+    // 在[data, data + len)中查找target首次出现的位置, 未找到返回len
+    static size_t Find(const char* data, size_t len, const char* target, size_t target_len);
+
+    // 去掉[data, data + len)尾部连续的c之后剩余的长度, 全部为c时返回0
+    static size_t TrimRight(const char* data, size_t len, char c);
+
+ private:
+    typedef size_t (*FindFunc)(const char* data, size_t len, const char* target, size_t target_len);
+    typedef size_t (*TrimFunc)(const char* data, size_t len, char c);
+
+ private:
+    static FindFunc SelectFind();
+
+    static TrimFunc SelectTrim();
+
+    static size_t FindScalar(const char* data, size_t len, const char* target, size_t target_len);
+
+    static size_t TrimRightScalar(const char* data, size_t len, char c);
+
+#if defined(__x86_64__) || defined(__i386__)
+    static size_t FindSse2(const char* data, size_t len, const char* target, size_t target_len);
+
+    static size_t FindAvx2(const char* data, size_t len, const char* target, size_t target_len);
+
+    static size_t TrimRightSse2(const char* data, size_t len, char c);
+
+    static size_t TrimRightAvx2(const char* data, size_t len, char c);
+#endif
+};
+
+} // namespace Imagine_Muduo
+
+#endif
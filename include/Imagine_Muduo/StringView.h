@@ -0,0 +1,66 @@
+#ifndef IMAGINE_MUDUO_STRINGVIEW_H
+#define IMAGINE_MUDUO_STRINGVIEW_H
+
+#include <stddef.h>
+#include <string>
+
+namespace Imagine_Muduo
+{
+
+/*
+-不持有数据的只读字符串视图(C++11没有std::string_view):
+    -只记录起始地址与长度, 拷贝代价与指针相同
+    -指向读缓冲区时只在读回调期间有效
+*/
+class StringView
+{
+ public:
+    static const size_t npos = static_cast<size_t>(-1);
+
+ public:
+    StringView();
+
+    StringView(const char* data, size_t len);
+
+    StringView(const char* str);
+
+    StringView(const std::string& str);
+
+    const char* GetData() const;
+
+    size_t GetLen() const;
+
+    bool IsEmpty() const;
+
+    char operator[](size_t idx) const;
+
+    const char* begin() const;
+
+    const char* end() const;
+
+    // 从pos开始的最多len个字符
+    StringView Substr(size_t pos, size_t len = npos) const;
+
+    // 返回字符c第一次出现的位置, 不存在时返回npos
+    size_t Find(char c, size_t pos = 0) const;
+
+    // 去掉首尾的空格与制表符
+    StringView Trim() const;
+
+    // 忽略ASCII大小写比较
+    bool EqualsIgnoreCase(const StringView& other) const;
+
+    bool operator==(const StringView& other) const;
+
+    bool operator!=(const StringView& other) const;
+
+    std::string ToString() const;
+
+ private:
+    const char* data_;
+    size_t len_;
+};
+
+} // namespace Imagine_Muduo
+
+#endif
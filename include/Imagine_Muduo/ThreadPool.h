@@ -2,20 +2,31 @@
 #define IMAGINE_MUDUO_THREADPOOL_H
 
 #include "log_macro.h"
+#include "common_definition.h"
 
 #include <pthread.h>
-#include <list>
+#include <deque>
+#include <atomic>
 #include <semaphore.h>
 #include <stdio.h>
+#include <stdint.h>
+#include <functional>
 
 namespace Imagine_Muduo
 {
 
+/*
+-任务调度:
+    -dispatcher通过PutTask把任务放入有界无锁注入队列(injection queue)
+    -worker优先从自己的双端队列尾部取任务, 其次从注入队列批量取任务到自己的双端队列, 最后从其它worker的双端队列头部窃取任务
+    -sem_仅用于空闲worker的休眠与唤醒
+    -注入队列已满时按OverloadPolicy处理, 被拒绝或丢弃的任务交给reject_handler_
+*/
 template <typename T>
 class ThreadPool
 {
  public:
-    ThreadPool(int thread_num = 10, int max_request = 10000);
+    ThreadPool(int thread_num = 10, int max_request = 10000, OverloadPolicy policy = OverloadPolicy::Block);
 
     ~ThreadPool();
 
@@ -25,18 +36,226 @@ class ThreadPool
 
     static void *Worker(void *data);
 
+    // 被拒绝或被丢弃的任务的处理函数, 在调用PutTask的线程上执行, 未设置时任务被直接丢弃
+    ThreadPool<T>* SetRejectHandler(std::function<void(T)> reject_handler);
+
+    size_t GetAcceptedCount() const;
+
+    size_t GetBlockedCount() const;
+
+    size_t GetRejectedCount() const;
+
+    size_t GetShedCount() const;
+
+ private:
+    // 有界多生产者多消费者无锁队列(Dmitry Vyukov的实现), 容量为2的幂
+    class InjectionQueue
+    {
+     public:
+        InjectionQueue(size_t capacity);
+
+        ~InjectionQueue();
+
+        bool TryPush(const T& task);
+
+        bool TryPop(T& task);
+
+     private:
+        struct Cell
+        {
+            std::atomic<size_t> sequence_;
+            T task_;
+        };
+
+     private:
+        Cell* cells_;
+        size_t mask_;
+        std::atomic<size_t> enqueue_pos_;
+        char padding_[64];                               // 避免生产者与消费者的下标处于同一cache line
+        std::atomic<size_t> dequeue_pos_;
+    };
+
+    // worker私有的双端队列, 持有者从尾部存取, 窃取者从头部取, 自旋锁只在窃取时才会产生竞争
+    class WorkerQueue
+    {
+     public:
+        WorkerQueue();
+
+        ~WorkerQueue();
+
+        void PushBack(const T& task);
+
+        bool PopBack(T& task);
+
+        bool PopFront(T& task);
+
+     private:
+        pthread_spinlock_t lock_;
+        std::deque<T> tasks_;
+        char padding_[64];                               // 避免相邻worker的队列处于同一cache line
+    };
+
+ private:
+    bool TryGetTask(T& task);
+
+    void RejectTask(const T& task);
+
+ private:
+    static const int batch_size_ = 4;                    // worker从注入队列一次最多取走的任务数
+    static thread_local int worker_idx_;                 // 当前线程对应的worker下标, 非worker线程为-1
+
  private:
     int thread_num_;
     int max_request_;
+    OverloadPolicy policy_;
     bool quit_;
     pthread_t *threads_;
-    std::list<T> tasks_;
-    pthread_mutex_t lock_;
+    InjectionQueue tasks_;
+    WorkerQueue *worker_queues_;
+    std::atomic<int> next_worker_idx_;
     sem_t sem_;
+    std::function<void(T)> reject_handler_;
+    std::atomic<int> blocked_waiters_;                   // Block策略下正在等待空位的生产者数目
+    sem_t space_sem_;                                    // Block策略下注入队列出现空位的通知
+
+    std::atomic<size_t> accepted_count_;                 // 成功入队的任务数
+    std::atomic<size_t> blocked_count_;                  // 因队列已满而阻塞过的PutTask次数
+    std::atomic<size_t> rejected_count_;                 // 被拒绝的任务数
+    std::atomic<size_t> shed_count_;                     // 被丢弃的最老任务数
 };
 
 template <typename T>
-ThreadPool<T>::ThreadPool(int thread_num, int max_request) : thread_num_(thread_num), max_request_(max_request), quit_(false), threads_(nullptr)
+thread_local int ThreadPool<T>::worker_idx_ = -1;
+
+template <typename T>
+ThreadPool<T>::InjectionQueue::InjectionQueue(size_t capacity) : cells_(nullptr), mask_(0), enqueue_pos_(0), dequeue_pos_(0)
+{
+    size_t size = 2;
+    while (size < capacity) {
+        size <<= 1;
+    }
+    cells_ = new Cell[size];
+    mask_ = size - 1;
+    for (size_t i = 0; i < size; i++) {
+        cells_[i].sequence_.store(i, std::memory_order_relaxed);
+    }
+}
+
+template <typename T>
+ThreadPool<T>::InjectionQueue::~InjectionQueue()
+{
+    delete[] cells_;
+}
+
+template <typename T>
+bool ThreadPool<T>::InjectionQueue::TryPush(const T& task)
+{
+    Cell* cell;
+    size_t pos = enqueue_pos_.load(std::memory_order_relaxed);
+    while (1) {
+        cell = &cells_[pos & mask_];
+        size_t sequence = cell->sequence_.load(std::memory_order_acquire);
+        intptr_t diff = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(pos);
+        if (diff == 0) {
+            if (enqueue_pos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                break;
+            }
+        } else if (diff < 0) {
+            // 队列已满
+            return false;
+        } else {
+            pos = enqueue_pos_.load(std::memory_order_relaxed);
+        }
+    }
+    cell->task_ = task;
+    cell->sequence_.store(pos + 1, std::memory_order_release);
+
+    return true;
+}
+
+template <typename T>
+bool ThreadPool<T>::InjectionQueue::TryPop(T& task)
+{
+    Cell* cell;
+    size_t pos = dequeue_pos_.load(std::memory_order_relaxed);
+    while (1) {
+        cell = &cells_[pos & mask_];
+        size_t sequence = cell->sequence_.load(std::memory_order_acquire);
+        intptr_t diff = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(pos + 1);
+        if (diff == 0) {
+            if (dequeue_pos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                break;
+            }
+        } else if (diff < 0) {
+            // 队列为空
+            return false;
+        } else {
+            pos = dequeue_pos_.load(std::memory_order_relaxed);
+        }
+    }
+    task = cell->task_;
+    cell->task_ = T();
+    cell->sequence_.store(pos + mask_ + 1, std::memory_order_release);
+
+    return true;
+}
+
+template <typename T>
+ThreadPool<T>::WorkerQueue::WorkerQueue()
+{
+    if (pthread_spin_init(&lock_, PTHREAD_PROCESS_PRIVATE) != 0) {
+        throw std::exception();
+    }
+}
+
+template <typename T>
+ThreadPool<T>::WorkerQueue::~WorkerQueue()
+{
+    pthread_spin_destroy(&lock_);
+}
+
+template <typename T>
+void ThreadPool<T>::WorkerQueue::PushBack(const T& task)
+{
+    pthread_spin_lock(&lock_);
+    tasks_.push_back(task);
+    pthread_spin_unlock(&lock_);
+}
+
+template <typename T>
+bool ThreadPool<T>::WorkerQueue::PopBack(T& task)
+{
+    pthread_spin_lock(&lock_);
+    if (tasks_.empty()) {
+        pthread_spin_unlock(&lock_);
+        return false;
+    }
+    task = tasks_.back();
+    tasks_.pop_back();
+    pthread_spin_unlock(&lock_);
+
+    return true;
+}
+
+template <typename T>
+bool ThreadPool<T>::WorkerQueue::PopFront(T& task)
+{
+    pthread_spin_lock(&lock_);
+    if (tasks_.empty()) {
+        pthread_spin_unlock(&lock_);
+        return false;
+    }
+    task = tasks_.front();
+    tasks_.pop_front();
+    pthread_spin_unlock(&lock_);
+
+    return true;
+}
+
+template <typename T>
+ThreadPool<T>::ThreadPool(int thread_num, int max_request, OverloadPolicy policy)
+    : thread_num_(thread_num), max_request_(max_request), policy_(policy), quit_(false), threads_(nullptr), tasks_(max_request > 0 ? max_request : 1), worker_queues_(nullptr), next_worker_idx_(0),
+      blocked_waiters_(0), accepted_count_(0), blocked_count_(0), rejected_count_(0), shed_count_(0)
 {
     if (thread_num < 0 || max_request < 0) {
         throw std::exception();
@@ -47,11 +266,13 @@ ThreadPool<T>::ThreadPool(int thread_num, int max_request) : thread_num_(thread_
         throw std::exception();
     }
 
-    if (pthread_mutex_init(&lock_, nullptr) != 0) {
+    worker_queues_ = new WorkerQueue[thread_num];
+
+    if (sem_init(&sem_, 0, 0) != 0) {
         throw std::exception();
     }
 
-    if (sem_init(&sem_, 0, 0) != 0) {
+    if (sem_init(&space_sem_, 0, 0) != 0) {
         throw std::exception();
     }
 
@@ -74,47 +295,143 @@ ThreadPool<T>::~ThreadPool()
 {
     delete[] threads_;
     quit_ = true;
-    pthread_mutex_destroy(&lock_);
+    delete[] worker_queues_;
     sem_destroy(&sem_);
+    sem_destroy(&space_sem_);
 }
 
 template <typename T>
 void ThreadPool<T>::PutTask(T task)
 {
-    if (tasks_.size() < static_cast<size_t>(max_request_)) {
-        pthread_mutex_lock(&lock_);
-        tasks_.push_back(task);
-        pthread_mutex_unlock(&lock_);
-        sem_post(&sem_);
-    } else {
-        // 给客户端返回一个错误码
+    // 注入队列的容量检查与入队是同一个原子操作, 不存在检查与入队之间的竞争
+    if (!tasks_.TryPush(task)) {
+        switch (policy_) {
+            case OverloadPolicy::Block:
+                {
+                    blocked_count_.fetch_add(1, std::memory_order_relaxed);
+                    blocked_waiters_++;
+                    while (!tasks_.TryPush(task)) {
+                        sem_wait(&space_sem_);
+                    }
+                    blocked_waiters_--;
+                    break;
+                }
+            case OverloadPolicy::Reject:
+                {
+                    RejectTask(task);
+                    return;
+                }
+            case OverloadPolicy::ShedOldest:
+                {
+                    T oldest_task;
+                    while (!tasks_.TryPush(task)) {
+                        if (tasks_.TryPop(oldest_task)) {
+                            shed_count_.fetch_add(1, std::memory_order_relaxed);
+                            if (reject_handler_) {
+                                reject_handler_(oldest_task);
+                            }
+                        }
+                    }
+                    break;
+                }
+        }
+    }
+    accepted_count_.fetch_add(1, std::memory_order_relaxed);
+    sem_post(&sem_);
+}
+
+template <typename T>
+void ThreadPool<T>::RejectTask(const T& task)
+{
+    rejected_count_.fetch_add(1, std::memory_order_relaxed);
+    if (reject_handler_) {
+        reject_handler_(task);
     }
 }
 
+template <typename T>
+bool ThreadPool<T>::TryGetTask(T& task)
+{
+    WorkerQueue* local_queue = worker_idx_ >= 0 ? worker_queues_ + worker_idx_ : nullptr;
+    if (local_queue != nullptr && local_queue->PopBack(task)) {
+        return true;
+    }
+
+    if (tasks_.TryPop(task)) {
+        // 顺带从注入队列多取几个任务放入本地队列, 空闲的worker可以从这里窃取
+        T extra_task;
+        for (int i = 1; local_queue != nullptr && i < batch_size_ && tasks_.TryPop(extra_task); i++) {
+            local_queue->PushBack(extra_task);
+        }
+        // 与生产者对blocked_waiters_的修改构成Dekker式同步, 避免生产者错过空位通知
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (blocked_waiters_ > 0) {
+            sem_post(&space_sem_);
+        }
+        return true;
+    }
+
+    for (int i = 1; i <= thread_num_; i++) {
+        int victim_idx = (worker_idx_ + i) % thread_num_;
+        if (victim_idx != worker_idx_ && worker_queues_[victim_idx].PopFront(task)) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
 template <typename T>
 T ThreadPool<T>::GetTask()
 {
     while (!quit_) {
-        sem_wait(&sem_);
-        pthread_mutex_lock(&lock_);
-        if (tasks_.empty()) {
-            pthread_mutex_unlock(&lock_);
-            continue;
+        T task;
+        if (TryGetTask(task)) {
+            return task;
         }
-        T task = tasks_.front();
-        tasks_.pop_front();
-        pthread_mutex_unlock(&lock_);
-
-        return task;
+        sem_wait(&sem_);
     }
 
     return nullptr;
 }
 
+template <typename T>
+ThreadPool<T>* ThreadPool<T>::SetRejectHandler(std::function<void(T)> reject_handler)
+{
+    reject_handler_ = reject_handler;
+
+    return this;
+}
+
+template <typename T>
+size_t ThreadPool<T>::GetAcceptedCount() const
+{
+    return accepted_count_.load(std::memory_order_relaxed);
+}
+
+template <typename T>
+size_t ThreadPool<T>::GetBlockedCount() const
+{
+    return blocked_count_.load(std::memory_order_relaxed);
+}
+
+template <typename T>
+size_t ThreadPool<T>::GetRejectedCount() const
+{
+    return rejected_count_.load(std::memory_order_relaxed);
+}
+
+template <typename T>
+size_t ThreadPool<T>::GetShedCount() const
+{
+    return shed_count_.load(std::memory_order_relaxed);
+}
+
 template <typename T>
 void *ThreadPool<T>::Worker(void *data)
 {
     ThreadPool<T> *threadpool = (ThreadPool<T> *)data;
+    worker_idx_ = threadpool->next_worker_idx_++;
     while (!threadpool->quit_) {
         T task = threadpool->GetTask();
         if (task) {
@@ -127,4 +444,4 @@ void *ThreadPool<T>::Worker(void *data)
 
 } // namespace Imagine_Muduo
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,88 @@
+#ifndef IMAGINE_MUDUO_TIMINGWHEEL_H
+#define IMAGINE_MUDUO_TIMINGWHEEL_H
+
+#include "common_typename.h"
+
+#include <vector>
+#include <unordered_map>
+
+namespace Imagine_Muduo
+{
+
+/*
+-分层时间轮(毫秒/秒/分钟/小时四层), 以毫秒为一个tick:
+    -插入与删除均为O(1), 定时器节点为侵入式双向链表节点, 由内部的对象池分配
+    -推进时高层的槽位在对应边界整体下沉到低层, 最低层的槽位到期即执行
+    -超过24小时的定时器先放在最高层, 下沉时重新计算所在层
+-时间轮只能在所属EventLoop的线程上使用, 不加锁
+*/
+class TimingWheel
+{
+ public:
+    TimingWheel();
+
+    ~TimingWheel();
+
+    // delay_ms为首次执行的相对时间, interval_ms为0表示只执行一次
+    void AddTimer(long long timer_id, TimerCallback timer_callback, long long delay_ms, long long interval_ms);
+
+    bool CancelTimer(long long timer_id);
+
+    // 推进到now_ms并执行所有到期的定时器
+    void Advance(long long now_ms);
+
+    // 下一次需要推进到的时刻(毫秒), -1表示没有定时器
+    long long GetNextExpire() const;
+
+    long long GetCurrentTime() const;
+
+    size_t GetTimerNum() const;
+
+    static long long GetNowMs();
+
+ private:
+    struct TimerNode
+    {
+        long long timer_id_;
+        TimerCallback timer_callback_;
+        long long expire_;
+        long long interval_;
+        int level_;
+        int slot_;
+        bool cancelled_;
+        TimerNode* prev_;
+        TimerNode* next_;
+    };
+
+ private:
+    TimerNode* AllocNode();
+
+    void FreeNode(TimerNode* node);
+
+    void Insert(TimerNode* node);
+
+    void Unlink(TimerNode* node);
+
+    void Cascade(int level);
+
+    void RunExpired();
+
+ private:
+    static const int level_num_ = 4;
+    static const int chunk_size_ = 256;                                  // 对象池每次向系统申请的节点数
+    static const int slot_nums_[level_num_];                             // 每层的槽位数
+    static const long long level_ticks_[level_num_];                     // 每层一个槽位对应的tick数
+
+ private:
+    long long current_;                                                  // 当前tick(毫秒)
+    std::vector<TimerNode*> slots_[level_num_];                          // 每个槽位的链表头
+    size_t timer_nums_[level_num_];                                      // 每层的定时器数目
+    std::unordered_map<long long, TimerNode*> timers_;                   // timer_id到节点的映射, 用于O(1)删除
+    TimerNode* running_node_;                                            // 正在执行回调的节点
+    TimerNode* free_list_;                                               // 对象池空闲链表
+    std::vector<TimerNode*> chunks_;                                     // 对象池向系统申请的内存块
+};
+
+} // namespace Imagine_Muduo
+
+#endif
@@ -0,0 +1,133 @@
+#ifndef IMAGINE_MUDUO_WEBSOCKET_H
+#define IMAGINE_MUDUO_WEBSOCKET_H
+
+#include "MessageView.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+namespace Imagine_Muduo
+{
+
+class WebSocketParser;
+
+/*
+-一条完整的WebSocket消息(或控制帧), 负载已经在读缓冲区中原地去掉掩码, 只在读回调期间有效
+*/
+class WebSocketMessage
+{
+   friend class WebSocketParser;
+
+ public:
+   enum class Opcode
+   {
+      Continuation = 0x0,
+      Text = 0x1,
+      Binary = 0x2,
+      Close = 0x8,
+      Ping = 0x9,
+      Pong = 0xa
+   };
+
+ public:
+   WebSocketMessage();
+
+   Opcode GetOpcode() const;
+
+   bool IsText() const;
+
+   bool IsBinary() const;
+
+   // 消息负载, 分片消息的每个分片为一个内存段
+   const MessageView& GetPayload() const;
+
+   // Close帧的状态码, 没有携带时为0
+   uint16_t GetCloseCode() const;
+
+ private:
+   Opcode opcode_;
+   MessageView payload_;
+   uint16_t close_code_;
+};
+
+/*
+-服务端WebSocket帧解析器:
+    -每次传入从读缓冲区起始位置开始的全部数据, 帧收全后才原地(SIMD XOR)去掉负载的掩码, 每个字节只处理一次
+    -分片消息的各个分片留在读缓冲区中, 最后一个分片到达后以多个内存段的形式一次交给调用者, 不搬移数据
+    -分片之间穿插的控制帧单独返回Control, 调用者处理后需要从读缓冲区中删除[GetFrameBegin(), GetFrameEnd())再继续解析
+    -客户端未加掩码、RSV不为0、控制帧分片或超过125字节、消息超出max_message_len等情况返回Error
+*/
+class WebSocketParser
+{
+ public:
+   enum class ParseStatus
+   {
+      InComplete = 0,
+      Complete,
+      Control,
+      Error
+   };
+
+ public:
+   // max_message_len限制一条消息(所有分片)的负载长度, 0表示不限制
+   WebSocketParser(size_t max_message_len = 0);
+
+   ParseStatus Parse(char* data, size_t len);
+
+   // 本次返回的消息或控制帧在读缓冲区中占用的范围
+   size_t GetFrameBegin() const;
+
+   size_t GetFrameEnd() const;
+
+   const WebSocketMessage& GetMessage() const;
+
+   WebSocketParser* SetMaxMessageLen(size_t max_message_len);
+
+   void Reset();
+
+   // 用4字节掩码mask对[data, data + len)原地异或
+   static void Unmask(char* data, size_t len, const char* mask);
+
+   // 生成不带掩码的服务端帧头, 返回帧头长度(最多max_header_len_字节)
+   static size_t EncodeHeader(char* header, WebSocketMessage::Opcode opcode, size_t payload_len, bool fin = true);
+
+ public:
+   static const size_t max_header_len_ = 10;          // 不带掩码的帧头最大长度
+
+ private:
+   typedef void (*UnmaskFunc)(char* data, size_t len, const char* mask);
+
+   struct Range
+   {
+      size_t begin_;
+      size_t len_;
+   };
+
+ private:
+   static UnmaskFunc SelectUnmask();
+
+   static void UnmaskScalar(char* data, size_t len, const char* mask);
+
+#if defined(__x86_64__) || defined(__i386__)
+   static void UnmaskSse2(char* data, size_t len, const char* mask);
+
+   static void UnmaskAvx2(char* data, size_t len, const char* mask);
+#endif
+
+ private:
+   size_t max_message_len_;
+   size_t next_frame_;                                // 下一帧的起始位置, 之前是当前消息已收到的分片
+   bool in_fragment_;                                 // 是否正在接收分片消息
+   bool message_done_;                                // 上一次返回了完整的数据消息, 下次解析前清空分片状态
+   WebSocketMessage::Opcode message_opcode_;          // 分片消息第一个分片的类型
+   size_t message_len_;                               // 当前消息已收到的负载长度
+   std::vector<Range> segments_;                      // 当前消息各分片负载的位置
+   size_t frame_begin_;
+   size_t frame_end_;
+   WebSocketMessage message_;
+};
+
+} // namespace Imagine_Muduo
+
+#endif
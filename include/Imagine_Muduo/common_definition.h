@@ -6,6 +6,14 @@
 namespace Imagine_Muduo
 {
 
+// 线程池任务队列已满时的处理策略
+enum class OverloadPolicy
+{
+    Block = 0,                  // 阻塞dispatcher直到队列有空位
+    Reject,                     // 拒绝新任务, 交给拒绝处理函数快速失败
+    ShedOldest                  // 丢弃队列中最老的任务(交给拒绝处理函数), 为新任务腾出空位
+};
+
 class HashPair
 {
  public:
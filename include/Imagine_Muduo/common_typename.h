@@ -13,6 +13,7 @@ class Connection;
 
 using EventHandler = std::function<void()>;                                     // 不同的Channel有不同的处理逻辑,暂时写死,不允许用户更改
 using ConnectionCallback = std::function<void(Connection* conn)>;
+using Functor = std::function<void()>;                                          // 投递到EventLoop线程上执行的任务
 
 using TimerCallback = ::Imagine_Tool::Imagine_Time::TimerCallback;
 using Timer = ::Imagine_Tool::Imagine_Time::Timer;
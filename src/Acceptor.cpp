@@ -39,20 +39,26 @@ Connection* Acceptor::Create(const std::shared_ptr<Channel>& channel) const
 
 void Acceptor::ReadHandler()
 {
-    if (loop_->GetChannelnum() >= loop_->GetMaxchannelnum()) {
-        IMAGINE_MUDUO_LOG("channel num over quantity! channel num is %d, max_channel_num is %d", loop_->GetChannelnum(), loop_->GetMaxchannelnum());
-        return;
-    } else {
-        std::shared_ptr<Channel> channel = Channel::Create(loop_, channel_->Getfd());
-        if (channel == nullptr) {
+    // 每次唤醒把全连接队列中已就绪的连接尽量取完(最多max_accept_num_个), 避免连接风暴时backlog被打满
+    for (int i = 0; i < max_accept_num_; i++) {
+        if (loop_->GetTotalChannelnum() >= loop_->GetMaxchannelnum()) {
+            IMAGINE_MUDUO_LOG("channel num over quantity! channel num is %d, max_channel_num is %d", loop_->GetTotalChannelnum(), loop_->GetMaxchannelnum());
             return;
         }
+        // 多Reactor模式下新连接交给从Reactor, 此后该连接的所有I/O都在从Reactor的线程上完成
+        EventLoop* io_loop = loop_->GetNextLoop();
+        std::shared_ptr<Channel> channel = Channel::Create(io_loop, channel_->Getfd());
+        if (channel == nullptr) {
+            break;
+        }
         channel->ParsePeerAddr();
         Connection* new_conn = CreateMessageConnection(channel);
         if (server_ != nullptr) {
             server_->AddAndSetConnection(new_conn);
         }
-        loop_->AddChannel(channel);
+        // 建立连接后从未发送数据的半开连接同样需要被空闲检测关闭
+        io_loop->TouchConnection(new_conn);
+        io_loop->AddChannel(channel);
     }
     channel_->SetEvents(EPOLLIN | EPOLLONESHOT | EPOLLRDHUP);
 }
@@ -62,6 +68,11 @@ void Acceptor::WriteHandler()
     return;
 }
 
+void Acceptor::OverloadHandler()
+{
+    channel_->HandleEvent();
+}
+
 void Acceptor::DefaultReadCallback(Connection* conn) const
 {
 }
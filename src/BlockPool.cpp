@@ -0,0 +1,108 @@
+#include "Imagine_Muduo/BlockPool.h"
+
+namespace Imagine_Muduo
+{
+
+const size_t BlockPool::block_size_;
+std::atomic<size_t> BlockPool::high_watermark_(1024);
+std::atomic<size_t> BlockPool::low_watermark_(256);
+std::mutex BlockPool::pools_lock_;
+std::list<BlockPool*> BlockPool::pools_;
+
+BlockPool::BlockPool() : acquire_num_(0), release_num_(0), system_alloc_num_(0), system_free_num_(0), cached_num_(0)
+{
+    std::unique_lock<std::mutex> lock(pools_lock_);
+    pools_.push_back(this);
+}
+
+BlockPool::~BlockPool()
+{
+    {
+        std::unique_lock<std::mutex> lock(pools_lock_);
+        pools_.remove(this);
+    }
+    Trim(0);
+}
+
+BlockPool* BlockPool::GetInstance()
+{
+    static thread_local BlockPool pool;
+
+    return &pool;
+}
+
+void BlockPool::SetWatermark(size_t high_watermark, size_t low_watermark)
+{
+    if (low_watermark > high_watermark) {
+        throw std::exception();
+    }
+    high_watermark_ = high_watermark;
+    low_watermark_ = low_watermark;
+}
+
+BlockPool::Stats BlockPool::GetGlobalStats()
+{
+    Stats global_stats = {0, 0, 0, 0, 0};
+    std::unique_lock<std::mutex> lock(pools_lock_);
+    for (std::list<BlockPool*>::iterator it = pools_.begin(); it != pools_.end(); it++) {
+        Stats stats = (*it)->GetStats();
+        global_stats.acquire_num_ += stats.acquire_num_;
+        global_stats.release_num_ += stats.release_num_;
+        global_stats.system_alloc_num_ += stats.system_alloc_num_;
+        global_stats.system_free_num_ += stats.system_free_num_;
+        global_stats.cached_num_ += stats.cached_num_;
+    }
+
+    return global_stats;
+}
+
+char* BlockPool::Acquire()
+{
+    Increase(acquire_num_);
+    if (free_blocks_.empty()) {
+        Increase(system_alloc_num_);
+        return new char[block_size_];
+    }
+    char* block = free_blocks_.back();
+    free_blocks_.pop_back();
+    cached_num_.store(free_blocks_.size(), std::memory_order_relaxed);
+
+    return block;
+}
+
+void BlockPool::Release(char* block)
+{
+    Increase(release_num_);
+    free_blocks_.push_back(block);
+    if (free_blocks_.size() > high_watermark_.load(std::memory_order_relaxed)) {
+        Trim(low_watermark_.load(std::memory_order_relaxed));
+    }
+    cached_num_.store(free_blocks_.size(), std::memory_order_relaxed);
+}
+
+BlockPool::Stats BlockPool::GetStats() const
+{
+    Stats stats = {acquire_num_.load(std::memory_order_relaxed), release_num_.load(std::memory_order_relaxed),
+                   system_alloc_num_.load(std::memory_order_relaxed), system_free_num_.load(std::memory_order_relaxed),
+                   cached_num_.load(std::memory_order_relaxed)};
+
+    return stats;
+}
+
+void BlockPool::Trim(size_t cached_num)
+{
+    while (free_blocks_.size() > cached_num) {
+        delete[] free_blocks_.back();
+        free_blocks_.pop_back();
+        Increase(system_free_num_);
+    }
+    cached_num_.store(free_blocks_.size(), std::memory_order_relaxed);
+}
+
+void BlockPool::Increase(std::atomic<size_t>& counter)
+{
+    // 只有所属线程会修改, 不需要原子的读-改-写
+    counter.store(counter.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+}
+
+} // namespace Imagine_Muduo
@@ -1,47 +1,70 @@
 #include "Imagine_Muduo/Buffer.h"
 
 #include "Imagine_Muduo/log_macro.h"
+#include "Imagine_Muduo/BlockPool.h"
+#include "Imagine_Muduo/SimdSearch.h"
+
+#include <sys/uio.h>
+#include <cstring>
+#include <algorithm>
 
 namespace Imagine_Muduo
 {
 
-Buffer::Buffer(size_t buffer_size)
+Buffer::Buffer() : buf_(nullptr), read_idx_(0), write_idx_(0), total_size_(0)
 {
-    buf_.reserve(buffer_size);
-    read_idx_ = 0;
-    write_idx_ = 0;
-    total_size_ = buffer_size;
 }
 
 Buffer::~Buffer()
 {
+    ReleaseStorage();
 }
 
-bool Buffer::Read(int fd)
+bool Buffer::Read(int fd, bool drain)
 {
-    while (1) {
-        char *temp_buf = new char[1000];
-        int bytes_num = recv(fd, temp_buf, 1000, 0);
+    // 可写空间不足时多出的数据先读到线程局部的溢出区, 再一次性拷贝进buf_, 避免每次读之前预先扩容
+    static thread_local char spill_buf[spill_size_];
+    struct iovec vec[2];
+    if (buf_ == nullptr) {
+        AllocateStorage(BlockPool::block_size_);
+    }
+    for (int i = 0; drain || i < max_read_num_; i++) {
+        size_t writable = total_size_ - write_idx_;
+        vec[0].iov_base = buf_ + write_idx_;
+        vec[0].iov_len = writable;
+        vec[1].iov_base = spill_buf;
+        vec[1].iov_len = spill_size_;
+        int iov_num = writable < spill_size_ ? 2 : 1;
+        ssize_t bytes_num = readv(fd, vec, iov_num);
         if (bytes_num == -1) {
-            delete[] temp_buf;
+            if (errno == EINTR) {
+                continue;
+            }
             if (errno == EAGAIN || errno == EWOULDBLOCK) {
-                // IMAGINE_MUDUO_LOG("数据读取完毕!\n");
                 break;
             }
 
             return false;
         } else if (bytes_num == 0) {
             // 对方关闭连接
-            delete[] temp_buf;
-
-            // IMAGINE_MUDUO_LOG("对方关闭连接!");
             return false;
         }
 
-        append(temp_buf, bytes_num);
-        delete[] temp_buf;
+        if (static_cast<size_t>(bytes_num) <= writable) {
+            write_idx_ += bytes_num;
+        } else {
+            write_idx_ = total_size_;
+            append(spill_buf, bytes_num - writable);
+        }
+
+        // 没有读满说明内核缓冲区已经读空; 边沿触发模式下仍需读到EAGAIN, 以免漏掉同一批到达的FIN
+        if (!drain && static_cast<size_t>(bytes_num) < writable + (iov_num == 2 ? spill_size_ : 0)) {
+            break;
+        }
+    }
+    if (GetLen() == 0) {
+        ReleaseStorage();
     }
-    // printf("num:%d\n",write_idx-read_idx);
 
     return true;
 }
@@ -57,49 +80,62 @@ int Buffer::Write(int fd)
 void Buffer::append(const char *data, size_t len)
 {
     EnsureWritableBytes(len);
-    for (size_t i = 0; i < len; i++) {
-        buf_[write_idx_ + i] = data[i];
-    }
+    memcpy(buf_ + write_idx_, data, len);
     write_idx_ += len;
 }
 
-std::string Buffer::RetrieveAsString(int len)
+std::string Buffer::RetrieveAsString(size_t len)
 {
     if (write_idx_ - read_idx_ < len) {
-        return nullptr;
-    }
-    std::string temp_string;
-    temp_string.reserve(len);
-    for (size_t i = 0; i < len; i++) {
-        temp_string[i] = buf_[read_idx_ + i];
+        throw std::exception();
     }
+    std::string temp_string(buf_ + read_idx_, len);
     read_idx_ += len;
+    if (GetLen() == 0) {
+        ReleaseStorage();
+    }
 
     return temp_string;
 }
 
 std::string Buffer::RetrieveAllString()
 {
-    std::string temp_string;
-    temp_string.reserve(write_idx_ - read_idx_);
-    for (size_t i = read_idx_, j = 0; i < write_idx_; i++, j++) {
-        temp_string.push_back(buf_[i]);
-    }
-    read_idx_ = write_idx_ = 0;
+    std::string temp_string(buf_ + read_idx_, write_idx_ - read_idx_);
+    ReleaseStorage();
 
     return temp_string;
 }
 
+std::shared_ptr<const char> Buffer::Pin()
+{
+    if (buf_ == nullptr) {
+        return nullptr;
+    }
+    if (!pin_) {
+        // 第一次Pin时把存储的所有权交给引用计数, 之后Buffer与所有Pin共同持有
+        pin_.reset(buf_, StorageDeleter(total_size_));
+    }
+
+    return pin_;
+}
+
 void Buffer::EnsureWritableBytes(size_t len)
 {
+    if (buf_ == nullptr) {
+        AllocateStorage(len);
+        return;
+    }
     if (total_size_ - write_idx_ < len) {
         if (total_size_ - write_idx_ + read_idx_ < len) {
-            buf_.reserve(total_size_ + len);
-            total_size_ += len;
+            // 按倍数扩容, 避免连续追加大块数据时反复扩容拷贝, 扩容时只拷贝未读取的数据
+            Relocate(std::max(write_idx_ - read_idx_ + len, total_size_ * 2));
         } else {
-            for (size_t i = read_idx_, j = 0; i < write_idx_; i++, j++) {
-                buf_[j] = buf_[i];
+            if (IsShared()) {
+                // 已读区域可能被MessageView持有, 不能原地移动
+                Relocate(total_size_);
+                return;
             }
+            memmove(buf_, buf_ + read_idx_, write_idx_ - read_idx_);
             write_idx_ -= read_idx_;
             read_idx_ = 0;
         }
@@ -111,31 +147,24 @@ const char* Buffer::Peek(size_t idx)
     return &buf_[read_idx_ + idx];
 }
 
-size_t Buffer::FindFirst(const std::string& target) const
+size_t Buffer::FindFirst(const std::string& target, size_t begin_idx) const
 {
-    if (target.size() == 0) {
-        return write_idx_ - read_idx_;
+    size_t len = write_idx_ - read_idx_;
+    if (begin_idx >= len) {
+        return len;
     }
-    for(size_t i = read_idx_; i < write_idx_; i++) {
-        if(buf_[i] == target[0]) {
-            bool flag = true;
-            for(size_t j = i; j < target.size(); j++) {
-                if (buf_[j] != target[j - i]) {
-                    flag = false;
-                    break;
-                }
-            }
-            if (flag) {
-                return i - read_idx_;
-            }
-        }
-    }
-    return write_idx_ - read_idx_;
+
+    return begin_idx + SimdSearch::Find(buf_ + read_idx_ + begin_idx, len - begin_idx, target.data(), target.size());
 }
 
 const char *Buffer::GetData() const
 {
-    return &buf_[read_idx_];
+    return buf_ + read_idx_;
+}
+
+char *Buffer::GetMutableData()
+{
+    return buf_ + read_idx_;
 }
 
 size_t Buffer::GetLen() const
@@ -145,40 +174,94 @@ size_t Buffer::GetLen() const
 
 void Buffer::Clear()
 {
-    read_idx_ = write_idx_ = 0;
-    total_size_ = buf_.capacity();
+    ReleaseStorage();
 }
 
 void Buffer::Clear(size_t begin_idx, size_t end_idx)
 {
     if (begin_idx >= GetLen() || end_idx > GetLen()) {
-        IMAGINE_MUDUO_LOG("clear buffer exception read idx is %zu, write idx is %zu, capacity is %zu, total size is %d", read_idx_, write_idx_, buf_.capacity(), total_size_);
+        IMAGINE_MUDUO_LOG("clear buffer exception read idx is %zu, write idx is %zu, total size is %zu", read_idx_, write_idx_, total_size_);
         IMAGINE_MUDUO_LOG("clear buffer exception begin idx is %zu, end_idx is %zu", begin_idx, end_idx);
         throw std::exception();
     }
     if (begin_idx == 0) {
         read_idx_ = read_idx_ + end_idx;
     } else {
+        if (IsShared()) {
+            Relocate(total_size_);
+        }
+        // 移动被删除区间两侧较短的一段
         if (begin_idx < write_idx_ - read_idx_ - end_idx) {
-            for(size_t i = read_idx_ + begin_idx - 1; i >= read_idx_; i--) {
-                buf_[i + end_idx - begin_idx] = buf_[i];
-            }
+            memmove(buf_ + read_idx_ + end_idx - begin_idx, buf_ + read_idx_, begin_idx);
             read_idx_ = read_idx_ + (end_idx - begin_idx);
         } else {
-            for(size_t i = read_idx_ + end_idx; i < write_idx_; i++) {
-                buf_[i - (end_idx - begin_idx)] = buf_[i];
-            }
+            memmove(buf_ + read_idx_ + begin_idx, buf_ + read_idx_ + end_idx, write_idx_ - read_idx_ - end_idx);
             write_idx_ = write_idx_ - (end_idx - begin_idx);
         }
     }
 
-    if (1000 < read_idx_ && static_cast<double>(write_idx_ - read_idx_) / buf_.size() < 0.5) {
-        for(size_t i = 0; i < write_idx_ - read_idx_; i++) {
-            buf_[i] = buf_[read_idx_ + i];
-        }
+    if (GetLen() == 0) {
+        // 数据取空后立即归还存储, 空闲连接不占用缓冲区内存
+        ReleaseStorage();
+    } else if (1000 < read_idx_ && static_cast<double>(write_idx_ - read_idx_) / total_size_ < 0.5 && !IsShared()) {
+        memmove(buf_, buf_ + read_idx_, write_idx_ - read_idx_);
         write_idx_ = write_idx_ - read_idx_;
         read_idx_ = 0;
     }
 }
 
+void Buffer::AllocateStorage(size_t len)
+{
+    // 不超过一个数据块的存储从线程局部的BlockPool获取, 更大的存储直接向系统申请
+    if (len <= BlockPool::block_size_) {
+        buf_ = BlockPool::GetInstance()->Acquire();
+        total_size_ = BlockPool::block_size_;
+    } else {
+        buf_ = new char[len];
+        total_size_ = len;
+    }
+}
+
+void Buffer::FreeStorage(char* buf, size_t size)
+{
+    if (size == BlockPool::block_size_) {
+        BlockPool::GetInstance()->Release(buf);
+    } else {
+        delete[] buf;
+    }
+}
+
+void Buffer::ReleaseStorage()
+{
+    if (pin_) {
+        // 存储由引用计数持有, 最后一个MessageView释放时才归还
+        pin_.reset();
+    } else if (buf_ != nullptr) {
+        FreeStorage(buf_, total_size_);
+    }
+    buf_ = nullptr;
+    read_idx_ = write_idx_ = total_size_ = 0;
+}
+
+bool Buffer::IsShared() const
+{
+    return pin_ && pin_.use_count() > 1;
+}
+
+void Buffer::Relocate(size_t size)
+{
+    char* old_buf = buf_;
+    size_t old_size = total_size_;
+    size_t data_len = write_idx_ - read_idx_;
+    std::shared_ptr<char> old_pin;
+    old_pin.swap(pin_);
+    AllocateStorage(size);
+    memcpy(buf_, old_buf + read_idx_, data_len);
+    if (!old_pin) {
+        FreeStorage(old_buf, old_size);
+    }
+    read_idx_ = 0;
+    write_idx_ = data_len;
+}
+
 } // namespace Imagine_Muduo
@@ -0,0 +1,314 @@
+#include "Imagine_Muduo/ChainBuffer.h"
+
+#include "Imagine_Muduo/log_macro.h"
+#include "Imagine_Muduo/BlockPool.h"
+
+#include <sys/uio.h>
+#include <sys/socket.h>
+#include <sys/sendfile.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <cstring>
+#include <algorithm>
+#include <errno.h>
+#include <netinet/in.h>
+#include <linux/errqueue.h>
+
+namespace Imagine_Muduo
+{
+
+ChainBuffer::ChainBuffer() : len_(0), appended_len_(0), sent_len_(0), file_len_(0), waiting_pipe_fd_(-1), zerocopy_next_seq_(0), zerocopy_done_seq_(0)
+{
+}
+
+ChainBuffer::~ChainBuffer()
+{
+    Clear();
+    if (!pinned_blocks_.empty()) {
+        // 内核可能仍在发送这些数据块, 归还BlockPool后被复用会改写发送的数据, 宁可不再回收
+        IMAGINE_MUDUO_LOG("drop %zu zerocopy blocks still referenced by kernel", pinned_blocks_.size());
+    }
+}
+
+void ChainBuffer::append(const char *data, size_t len)
+{
+    while (len) {
+        if (blocks_.empty() || blocks_.back().write_idx_ == BlockPool::block_size_) {
+            Block block = {BlockPool::GetInstance()->Acquire(), 0, 0, 0, false};
+            blocks_.push_back(block);
+        }
+        Block& tail = blocks_.back();
+        size_t copy_len = std::min(len, BlockPool::block_size_ - tail.write_idx_);
+        memcpy(tail.data_ + tail.write_idx_, data, copy_len);
+        tail.write_idx_ += copy_len;
+        data += copy_len;
+        len -= copy_len;
+        len_ += copy_len;
+        appended_len_ += copy_len;
+    }
+}
+
+void ChainBuffer::AppendFile(int fd, off_t offset, size_t len, bool close_fd)
+{
+    FileItem item = {appended_len_, fd, offset, len, false, close_fd};
+    files_.push_back(item);
+    file_len_ += len;
+}
+
+void ChainBuffer::AppendPipe(int pipe_fd, size_t len, bool close_fd)
+{
+    FileItem item = {appended_len_, pipe_fd, 0, len, true, close_fd};
+    files_.push_back(item);
+    file_len_ += len;
+}
+
+ssize_t ChainBuffer::Write(int fd, bool zerocopy)
+{
+    ssize_t total_bytes = 0;
+    struct iovec vec[max_iov_num_];
+    waiting_pipe_fd_ = -1;
+    while (!IsEmpty()) {
+        if (!files_.empty() && files_.front().position_ == sent_len_) {
+            // 此前写入的内存数据已全部发送, 轮到文件/管道数据
+            ssize_t bytes_num = WriteFile(fd, files_.front());
+            if (bytes_num == -1) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                    // socket发送缓冲区已满, 或管道暂时没有数据(由waiting_pipe_fd_区分)
+                    break;
+                }
+                IMAGINE_MUDUO_LOG("sendfile/splice exception, errno is %d", errno);
+
+                return -1;
+            }
+            total_bytes += bytes_num;
+            continue;
+        }
+        // 只发送到下一个文件/管道数据之前的内存数据
+        size_t limit = files_.empty() ? len_ : files_.front().position_ - sent_len_;
+        int iov_num = 0;
+        for (size_t i = 0; i < blocks_.size() && iov_num < max_iov_num_ && limit; i++) {
+            vec[iov_num].iov_base = blocks_[i].data_ + blocks_[i].read_idx_;
+            vec[iov_num].iov_len = std::min(limit, blocks_[i].write_idx_ - blocks_[i].read_idx_);
+            limit -= vec[iov_num].iov_len;
+            iov_num++;
+        }
+        // 使用sendmsg代替writev以携带MSG_NOSIGNAL, 对端已关闭时返回EPIPE而不是触发SIGPIPE
+        struct msghdr msg;
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_iov = vec;
+        msg.msg_iovlen = iov_num;
+        int flags = MSG_NOSIGNAL;
+        if (zerocopy) {
+            flags |= MSG_ZEROCOPY;
+        }
+        if (limit || !files_.empty()) {
+            // 本次之后还有数据(超出iovec数目的数据块或文件/管道数据), 提示内核暂不推送未满的报文
+            flags |= MSG_MORE;
+        }
+        ssize_t bytes_num = sendmsg(fd, &msg, flags);
+        if (bytes_num == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (zerocopy && errno == ENOBUFS) {
+                // 超出optmem限制无法再固定用户内存, 本次改用拷贝发送
+                zerocopy = false;
+                continue;
+            }
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                break;
+            }
+            IMAGINE_MUDUO_LOG("writev exception, errno is %d", errno);
+
+            return -1;
+        }
+        if (zerocopy && bytes_num > 0) {
+            MarkZeroCopy(bytes_num);
+        }
+        Retrieve(bytes_num);
+        total_bytes += bytes_num;
+    }
+
+    return total_bytes;
+}
+
+void ChainBuffer::MarkZeroCopy(size_t len)
+{
+    // 内核为每次成功的MSG_ZEROCOPY发送分配一个递增的序号, 完成通知按序号区间返回
+    uint32_t seq = zerocopy_next_seq_++;
+    zerocopy_done_.push_back(false);
+    for (size_t i = 0; i < blocks_.size() && len; i++) {
+        blocks_[i].zerocopy_seq_ = seq;
+        blocks_[i].zerocopy_ = true;
+        len -= std::min(len, blocks_[i].write_idx_ - blocks_[i].read_idx_);
+    }
+}
+
+bool ChainBuffer::IsZeroCopyPending(const Block& block) const
+{
+    return block.zerocopy_ && static_cast<uint32_t>(block.zerocopy_seq_ - zerocopy_done_seq_) < zerocopy_done_.size();
+}
+
+void ChainBuffer::ReleaseBlock(const Block& block)
+{
+    if (IsZeroCopyPending(block)) {
+        // 内核可能仍在读取该数据块, 等到完成通知后再归还
+        PinnedBlock pinned = {block.zerocopy_seq_, block.data_};
+        pinned_blocks_.push_back(pinned);
+    } else {
+        BlockPool::GetInstance()->Release(block.data_);
+    }
+}
+
+size_t ChainBuffer::ReapZeroCopy(int fd)
+{
+    size_t reaped_num = 0;
+    while (true) {
+        char control[128];
+        struct msghdr msg;
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_control = control;
+        msg.msg_controllen = sizeof(control);
+        if (recvmsg(fd, &msg, MSG_ERRQUEUE) == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            break;
+        }
+        for (struct cmsghdr* cm = CMSG_FIRSTHDR(&msg); cm != nullptr; cm = CMSG_NXTHDR(&msg, cm)) {
+            if (!((cm->cmsg_level == SOL_IP && cm->cmsg_type == IP_RECVERR) || (cm->cmsg_level == SOL_IPV6 && cm->cmsg_type == IPV6_RECVERR))) {
+                continue;
+            }
+            struct sock_extended_err* err = (struct sock_extended_err*)CMSG_DATA(cm);
+            if (err->ee_errno != 0 || err->ee_origin != SO_EE_ORIGIN_ZEROCOPY) {
+                continue;
+            }
+            // [ee_info, ee_data]区间内的发送已完成
+            for (uint32_t seq = err->ee_info; seq != err->ee_data + 1; seq++) {
+                uint32_t idx = seq - zerocopy_done_seq_;
+                if (idx < zerocopy_done_.size()) {
+                    zerocopy_done_[idx] = true;
+                }
+            }
+            reaped_num++;
+        }
+    }
+    // 序号之前的发送全部完成后才推进, 依次归还不再被内核引用的数据块
+    while (!zerocopy_done_.empty() && zerocopy_done_.front()) {
+        zerocopy_done_.pop_front();
+        zerocopy_done_seq_++;
+    }
+    while (!pinned_blocks_.empty() && static_cast<uint32_t>(pinned_blocks_.front().seq_ - zerocopy_done_seq_) >= zerocopy_done_.size()) {
+        BlockPool::GetInstance()->Release(pinned_blocks_.front().data_);
+        pinned_blocks_.pop_front();
+    }
+
+    return reaped_num;
+}
+
+int ChainBuffer::GetWaitingPipe() const
+{
+    return waiting_pipe_fd_;
+}
+
+size_t ChainBuffer::GetPinnedBlockNum() const
+{
+    return pinned_blocks_.size();
+}
+
+ssize_t ChainBuffer::WriteFile(int fd, FileItem& item)
+{
+    ssize_t bytes_num;
+    if (item.is_pipe_) {
+        unsigned int flags = SPLICE_F_MOVE | SPLICE_F_NONBLOCK;
+        if (len_ || files_.size() > 1) {
+            flags |= SPLICE_F_MORE;
+        }
+        bytes_num = splice(item.fd_, nullptr, fd, nullptr, item.len_, flags);
+        if (bytes_num == -1 && errno == EAGAIN) {
+            // SPLICE_F_NONBLOCK下管道为空与socket不可写都返回EAGAIN, 管道没有数据(也未关闭写端)时需要等待管道可读而不是EPOLLOUT
+            struct pollfd pipe_poll = {item.fd_, POLLIN, 0};
+            if (poll(&pipe_poll, 1, 0) == 0) {
+                waiting_pipe_fd_ = item.fd_;
+            }
+            errno = EAGAIN;
+        }
+    } else {
+        bytes_num = sendfile(fd, item.fd_, &item.offset_, item.len_);
+    }
+    if (bytes_num == -1) {
+        return -1;
+    }
+    item.len_ -= bytes_num;
+    file_len_ -= bytes_num;
+    // 返回0说明文件/管道提前结束, 剩余部分不再发送
+    if (item.len_ == 0 || bytes_num == 0) {
+        file_len_ -= item.len_;
+        if (item.close_fd_) {
+            close(item.fd_);
+        }
+        files_.pop_front();
+    }
+
+    return bytes_num;
+}
+
+void ChainBuffer::Retrieve(size_t len)
+{
+    len = std::min(len, len_);
+    len_ -= len;
+    sent_len_ += len;
+    while (len) {
+        Block& head = blocks_.front();
+        size_t block_len = std::min(len, head.write_idx_ - head.read_idx_);
+        head.read_idx_ += block_len;
+        len -= block_len;
+        if (head.read_idx_ == head.write_idx_) {
+            // 发送完的数据块立即归还BlockPool(零拷贝发送的数据块等到完成通知后归还), 没有待发送数据的连接不持有数据块
+            ReleaseBlock(head);
+            blocks_.pop_front();
+        }
+    }
+}
+
+size_t ChainBuffer::GetLen() const
+{
+    return len_;
+}
+
+size_t ChainBuffer::GetFileLen() const
+{
+    return file_len_;
+}
+
+bool ChainBuffer::IsEmpty() const
+{
+    return len_ == 0 && files_.empty();
+}
+
+size_t ChainBuffer::GetBlockNum() const
+{
+    return blocks_.size();
+}
+
+void ChainBuffer::Clear()
+{
+    for (size_t i = 0; i < blocks_.size(); i++) {
+        ReleaseBlock(blocks_[i]);
+    }
+    blocks_.clear();
+    for (size_t i = 0; i < files_.size(); i++) {
+        if (files_[i].close_fd_) {
+            close(files_[i].fd_);
+        }
+    }
+    files_.clear();
+    len_ = appended_len_ = sent_len_ = file_len_ = 0;
+    waiting_pipe_fd_ = -1;
+}
+
+} // namespace Imagine_Muduo
@@ -4,6 +4,9 @@
 #include "Imagine_Muduo/EventLoop.h"
 #include "Imagine_Muduo/Buffer.h"
 
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+
 namespace Imagine_Muduo
 {
 
@@ -21,6 +24,7 @@ void Channel::Init()
     handler_ = nullptr;
     read_handler_ = nullptr;
     write_handler_ = nullptr;
+    overload_handler_ = nullptr;
 }
 
 Channel* Channel::MakeSelf(std::shared_ptr<Channel> self)
@@ -177,13 +181,28 @@ std::shared_ptr<Channel> Channel::Create(EventLoop *loop, int value, ChannelTyep
             throw std::exception();
         }
         setsockopt(sockfd, SOL_SOCKET, SO_REUSEPORT, &reuse, sizeof(reuse)); // 设置端口复用
-        events = EPOLLIN | EPOLLRDHUP | EPOLLONESHOT;
-    } else if (type == TimerChannel) { // 创建timerChannel
-
+        if (loop->IsEdgeTriggered()) {
+            events = EPOLLIN | EPOLLRDHUP | EPOLLET;
+        } else {
+            events = EPOLLIN | EPOLLRDHUP | EPOLLONESHOT;
+        }
+    } else if (type == TimerChannel) { // 创建timerChannel, 由loop线程直接处理, 不需要EPOLLONESHOT
         new_channel->SetReadHandler(std::bind(&Channel::DefaultTimerfdReadEventHandler, new_channel.get()));
-        sockfd = TimeUtil::CreateTimer();
-        setsockopt(sockfd, SOL_SOCKET, SO_REUSEPORT, &reuse, sizeof(reuse)); // 设置端口复用
-        events = EPOLLIN | EPOLLRDHUP | EPOLLONESHOT | EPOLLET;
+        sockfd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+        if (sockfd == -1) {
+            IMAGINE_MUDUO_LOG("create timerfd exception");
+            throw std::exception();
+        }
+        events = EPOLLIN;
+        listenfd = 0;
+    } else if (type == WakeupChannel) { // 创建用于唤醒EventLoop的eventfd Channel, 由loop线程直接处理, 不需要EPOLLONESHOT
+        new_channel->SetReadHandler(std::bind(&Channel::DefaultEventfdReadEventHandler, new_channel.get()));
+        sockfd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if (sockfd == -1) {
+            IMAGINE_MUDUO_LOG("create eventfd exception");
+            throw std::exception();
+        }
+        events = EPOLLIN;
         listenfd = 0;
     } else { // 创建监听Channel
         listenfd = sockfd = socket(PF_INET, SOCK_STREAM, 0);
@@ -234,32 +253,43 @@ void Channel::HandleEvent()
 
 void Channel::DefaultEventHandler()
 {
+    if ((revents_ & EPOLLERR) && completion_handler_) {
+        completion_handler_();
+    }
     if ((revents_ & EPOLLIN) && read_handler_) {
         read_handler_();
-    } else if ((revents_ & EPOLLOUT) && write_handler_) {
+        // EPOLLONESHOT模式下一次只关注一种事件; 边沿触发模式下读写可能同时就绪, 但读处理中连接可能已被关闭
+        if (!(events_ & EPOLLET) || !self_) {
+            return;
+        }
+    }
+    if ((revents_ & EPOLLOUT) && write_handler_) {
         write_handler_();
     }
 }
 
+void Channel::HandleOverload()
+{
+    if (overload_handler_) {
+        overload_handler_();
+    } else {
+        HandleEvent();
+    }
+}
+
 void Channel::DefaultTimerfdReadEventHandler()
 {
-    TimeStamp now(NOW_MS);
-    TimeUtil::ReadTimerfd(this->Getfd());
-    std::vector<Timer *> expired_timers = GetLoop()->GetExpiredTimers(now);
-    SetEvents(EPOLLIN | EPOLLONESHOT | EPOLLRDHUP | EPOLLET);
-    for (size_t i = 0; i < expired_timers.size(); i++) {
-        if (!expired_timers[i]->IsAlive()) {
-            delete expired_timers[i];
-        } else {
-            expired_timers[i]->RunCallback();
-            if (expired_timers[i]->ResetCallTime()) {
-                GetLoop()->InsertTimer(expired_timers[i]);
-            } else {
-                GetLoop()->CloseTimer(expired_timers[i]->GetTimerId());
-                delete expired_timers[i];
-            }
-        }
+    uint64_t expirations;
+    if (read(fd_, &expirations, sizeof(expirations)) < 0 && errno != EAGAIN) {
+        IMAGINE_MUDUO_LOG("read timerfd exception");
     }
+    GetLoop()->HandleTimers();
+}
+
+void Channel::DefaultEventfdReadEventHandler()
+{
+    eventfd_t value;
+    eventfd_read(fd_, &value);
 }
 
 Channel* Channel::SetReadHandler(EventHandler read_handler)
@@ -283,4 +313,18 @@ Channel* Channel::SetEventHandler(EventHandler handler)
     return this;
 }
 
+Channel* Channel::SetOverloadHandler(EventHandler overload_handler)
+{
+    overload_handler_ = overload_handler;
+
+    return this;
+}
+
+Channel* Channel::SetCompletionHandler(EventHandler completion_handler)
+{
+    completion_handler_ = completion_handler;
+
+    return this;
+}
+
 } // namespace Imagine_Muduo
\ No newline at end of file
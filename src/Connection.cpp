@@ -3,7 +3,18 @@
 #include "Imagine_Muduo/log_macro.h"
 #include "Imagine_Muduo/Server.h"
 #include "Imagine_Muduo/Buffer.h"
+#include "Imagine_Muduo/ChainBuffer.h"
 #include "Imagine_Muduo/Channel.h"
+#include "Imagine_Muduo/EventLoop.h"
+#include "Imagine_Muduo/SimdSearch.h"
+#include "Imagine_Muduo/HttpParser.h"
+#include "Imagine_Muduo/WebSocket.h"
+
+#include <stdint.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <unistd.h>
 
 namespace Imagine_Muduo
 {
@@ -27,26 +38,54 @@ Connection::~Connection()
 {
     delete read_buffer_;
     delete write_buffer_;
+    delete http_parser_;
+    delete ws_parser_;
 }
 
 Connection* Connection::Init()
 {
     msg_format_ = MessageFormat::None;
     msg_status_ = MessageStatus::None;
+    searched_len_ = 0;
+    length_field_ = LengthField::UInt32;
+    big_endian_ = true;
+    header_offset_ = 0;
+    max_frame_len_ = 0;
+    header_len_ = 0;
+    frame_len_ = 0;
+    http_parser_ = nullptr;
+    ws_parser_ = nullptr;
+    ws_close_sent_ = false;
     keep_alive_ = true;
     next_event_ = Event::Read;
     get_next_msg_ = false;
     read_buffer_ = new Buffer();
-    write_buffer_ = new Buffer();
+    write_buffer_ = new ChainBuffer();
     clear_read_buffer_ = true;
     clear_write_buffer_ = true;
+    write_in_progress_ = false;
+    read_paused_ = false;
+    above_high_water_mark_ = false;
+    zerocopy_enabled_ = false;
+    zerocopy_unsupported_ = false;
+    flush_queued_ = false;
+    pipe_channel_ = nullptr;
+    active_time_ = 0;
+    idle_linked_ = false;
+    idle_closed_ = false;
     if (channel_.get() != nullptr) {
         loop_ = channel_->GetLoop();
         channel_->SetReadHandler(std::bind(&Connection::ReadHandler, this));
         channel_->SetWriteHandler(std::bind(&Connection::WriteHandler, this));
+        channel_->SetOverloadHandler(std::bind(&Connection::OverloadHandler, this));
+        channel_->SetCompletionHandler(std::bind(&Connection::CompletionHandler, this));
     }
     SetReadCallback(std::bind(&Connection::DefaultReadCallback, this, std::placeholders::_1));
     SetWriteCallback(std::bind(&Connection::DefaultWriteCallback, this, std::placeholders::_1));
+    SetOverloadCallback(std::bind(&Connection::DefaultOverloadCallback, this, std::placeholders::_1));
+    SetWriteCompleteCallback(std::bind(&Connection::DefaultWriteCompleteCallback, this, std::placeholders::_1));
+    SetHighWaterMarkCallback(std::bind(&Connection::DefaultHighWaterMarkCallback, this, std::placeholders::_1));
+    SetLowWaterMarkCallback(std::bind(&Connection::DefaultLowWaterMarkCallback, this, std::placeholders::_1));
 
     return this;
 }
@@ -56,7 +95,9 @@ void Connection::PackageCoalescingDetector()
     size_t read_size = read_buffer_->GetLen();
     msg_begin_idx_ = 0;
     msg_end_idx_ = read_size;
+    frame_end_idx_ = read_size;
     if (msg_format_ == MessageFormat::None) {
+        msg_status_ = MessageStatus::Complete;
         return;
     }
     switch (msg_format_) {
@@ -68,36 +109,316 @@ void Connection::PackageCoalescingDetector()
             {
                 if (read_size < msg_length_) {
                     msg_status_ = MessageStatus::InComplete;
-                } else if (read_size > msg_length_) {
-                    msg_status_ = MessageStatus::OverComplete;
+                } else {
+                    msg_status_ = read_size > msg_length_ ? MessageStatus::OverComplete : MessageStatus::Complete;
+                    frame_end_idx_ = msg_length_;
                     msg_end_idx_ = msg_length_;
-                    for(size_t idx = msg_end_idx_ - 1; idx >= msg_begin_idx_; idx--) {
-                        if (*(read_buffer_->Peek(idx)) != place_holder_) {
-                            msg_end_idx_ = idx + 1;
-                            break;
+                    if (msg_status_ == MessageStatus::OverComplete) {
+                        // 去掉消息尾部的填充字符(填充字符仍属于该帧, 清理时一并删除), 消息全部由填充字符组成时保留原长度
+                        msg_end_idx_ = SimdSearch::TrimRight(read_buffer_->GetData(), msg_length_, place_holder_);
+                        if (msg_end_idx_ == msg_begin_idx_) {
+                            msg_end_idx_ = msg_length_;
                         }
                     }
-                } else {
-                    msg_status_ = MessageStatus::Complete;
-                    msg_end_idx_ = msg_length_;
                 }
                 break;
             }
         case MessageFormat::SpecialEOF:
             {
-                msg_end_idx_ = read_buffer_->FindFirst(eof_) + eof_.size();
-                if (msg_end_idx_ > read_size) {
-                    msg_status_ = MessageStatus::InComplete;
-                } else if (msg_end_idx_ < read_size) {
-                    msg_status_ = MessageStatus::OverComplete;
-                } else {
+                if (eof_.empty()) {
                     msg_status_ = MessageStatus::Complete;
+                    break;
+                }
+                // 从上次未找到分隔符的位置继续查找(回退eof_.size() - 1字节以覆盖跨两次读取的分隔符), 每个字节只检查一次
+                size_t search_begin = searched_len_ >= eof_.size() ? searched_len_ - eof_.size() + 1 : 0;
+                size_t eof_idx = read_buffer_->FindFirst(eof_, search_begin);
+                if (eof_idx == read_size) {
+                    msg_status_ = MessageStatus::InComplete;
+                    searched_len_ = read_size;
+                    break;
                 }
+                searched_len_ = 0;
+                msg_end_idx_ = frame_end_idx_ = eof_idx + eof_.size();
+                msg_status_ = msg_end_idx_ < read_size ? MessageStatus::OverComplete : MessageStatus::Complete;
+                break;
+            }
+        case MessageFormat::LengthPrefixed:
+            {
+                // 消息头只解码一次, 消息体未收全时保留frame_len_, 后续数据到达时只比较长度
+                if (!frame_len_) {
+                    msg_status_ = DecodeLengthPrefix(read_buffer_->GetData(), read_size);
+                    if (msg_status_ != MessageStatus::Complete) {
+                        break;
+                    }
+                }
+                if (read_size < frame_len_) {
+                    msg_status_ = MessageStatus::InComplete;
+                    break;
+                }
+                msg_end_idx_ = frame_end_idx_ = frame_len_;
+                msg_status_ = frame_len_ < read_size ? MessageStatus::OverComplete : MessageStatus::Complete;
+                frame_len_ = 0;
+                break;
+            }
+        case MessageFormat::Http:
+            {
+                if (!keep_alive_) {
+                    // 之前的请求要求关闭连接, 不再处理后续的流水线请求
+                    msg_status_ = MessageStatus::InComplete;
+                    break;
+                }
+                HttpParser::ParseStatus status = http_parser_->Parse(read_buffer_->GetData(), read_size);
+                if (status != HttpParser::ParseStatus::Complete) {
+                    msg_status_ = status == HttpParser::ParseStatus::Error ? MessageStatus::Error : MessageStatus::InComplete;
+                    break;
+                }
+                msg_end_idx_ = frame_end_idx_ = http_parser_->GetParsedLen();
+                msg_status_ = frame_end_idx_ < read_size ? MessageStatus::OverComplete : MessageStatus::Complete;
+                keep_alive_ = http_parser_->GetRequest().IsKeepAlive();
+                break;
+            }
+        case MessageFormat::WebSocket:
+            {
+                WebSocketParser::ParseStatus status = WebSocketParser::ParseStatus::InComplete;
+                while (keep_alive_) {
+                    // 负载在读缓冲区中原地去掉掩码, 分片之间的控制帧处理后立即从读缓冲区中删除, 已收到的分片位置不受影响
+                    status = ws_parser_->Parse(read_buffer_->GetMutableData(), read_buffer_->GetLen());
+                    if (status != WebSocketParser::ParseStatus::Control) {
+                        break;
+                    }
+                    ProcessWebSocketControl(ws_parser_->GetMessage());
+                    read_buffer_->Clear(ws_parser_->GetFrameBegin(), ws_parser_->GetFrameEnd());
+                }
+                if (!keep_alive_ || status == WebSocketParser::ParseStatus::InComplete) {
+                    // 关闭握手后不再处理后续的帧
+                    msg_status_ = MessageStatus::InComplete;
+                    break;
+                }
+                if (status == WebSocketParser::ParseStatus::Error) {
+                    msg_status_ = MessageStatus::Error;
+                    break;
+                }
+                read_size = read_buffer_->GetLen();
+                msg_end_idx_ = frame_end_idx_ = ws_parser_->GetFrameEnd();
+                msg_status_ = frame_end_idx_ < read_size ? MessageStatus::OverComplete : MessageStatus::Complete;
                 break;
             }
     }
 }
 
+void Connection::ProcessWebSocketControl(const WebSocketMessage& message)
+{
+    switch (message.GetOpcode()) {
+        case WebSocketMessage::Opcode::Ping:
+            {
+                SendWebSocketFrame(WebSocketMessage::Opcode::Pong, message.GetPayload().GetData(), message.GetPayload().GetLen());
+                break;
+            }
+        case WebSocketMessage::Opcode::Close:
+            {
+                if (!ws_close_sent_) {
+                    // 回复对端的状态码
+                    size_t len = message.GetPayload().GetLen() < 2 ? message.GetPayload().GetLen() : 2;
+                    SendWebSocketFrame(WebSocketMessage::Opcode::Close, message.GetPayload().GetData(), len);
+                    ws_close_sent_ = true;
+                }
+                keep_alive_ = false;
+                break;
+            }
+        default:
+            {
+                break;
+            }
+    }
+}
+
+Connection::MessageStatus Connection::DecodeLengthPrefix(const char* data, size_t len)
+{
+    if (len <= header_offset_) {
+        return MessageStatus::InComplete;
+    }
+    const unsigned char* field = reinterpret_cast<const unsigned char*>(data) + header_offset_;
+    size_t field_len = len - header_offset_;
+    unsigned long long body_len = 0;
+    size_t length_size = 0;
+    switch (length_field_) {
+        case LengthField::UInt16:
+        case LengthField::UInt32:
+            {
+                length_size = length_field_ == LengthField::UInt16 ? 2 : 4;
+                if (field_len < length_size) {
+                    return MessageStatus::InComplete;
+                }
+                for (size_t i = 0; i < length_size; i++) {
+                    size_t idx = big_endian_ ? i : length_size - 1 - i;
+                    body_len = (body_len << 8) | field[idx];
+                }
+                break;
+            }
+        case LengthField::Varint:
+            {
+                // 最多10字节表示64位长度
+                length_size = 0;
+                while (true) {
+                    if (length_size == field_len) {
+                        return MessageStatus::InComplete;
+                    }
+                    if (length_size == 10) {
+                        return MessageStatus::Error;
+                    }
+                    body_len |= static_cast<unsigned long long>(field[length_size] & 0x7f) << (7 * length_size);
+                    if (!(field[length_size++] & 0x80)) {
+                        break;
+                    }
+                }
+                break;
+            }
+        default:
+            {
+                return MessageStatus::Error;
+            }
+    }
+    size_t header_len = header_offset_ + length_size;
+    if (body_len > static_cast<unsigned long long>(SIZE_MAX - header_len) || (max_frame_len_ && header_len + body_len > max_frame_len_)) {
+        return MessageStatus::Error;
+    }
+    header_len_ = header_len;
+    frame_len_ = header_len + body_len;
+
+    return MessageStatus::Complete;
+}
+
+void Connection::OverloadHandler()
+{
+    overload_callback_(this);
+    if (!write_buffer_->IsEmpty()) {
+        write_buffer_->Write(channel_->Getfd());
+    }
+    server_->CloseConnection(GetPeerIp(), GetPeerPort());
+}
+
+void Connection::CompletionHandler()
+{
+    size_t reaped_num = zerocopy_enabled_ ? write_buffer_->ReapZeroCopy(channel_->Getfd()) : 0;
+    if (channel_->GetRevents() & (EPOLLIN | EPOLLOUT)) {
+        // 随后的读写处理函数会重新注册事件或关闭连接
+        return;
+    }
+    if (!reaped_num) {
+        // 不是完成通知引起的EPOLLERR, 连接出错时关闭, 否则重新注册事件
+        int error = 0;
+        socklen_t error_len = sizeof(error);
+        if (getsockopt(channel_->Getfd(), SOL_SOCKET, SO_ERROR, &error, &error_len) != 0 || error || (channel_->GetRevents() & EPOLLHUP)) {
+            IMAGINE_MUDUO_LOG("socket error, errno is %d", error);
+            server_->CloseConnection(GetPeerIp(), GetPeerPort());
+            return;
+        }
+    }
+    // EPOLLONESHOT模式下没有读写事件时不会进入读写处理函数, 需要在这里重新注册事件
+    if (!loop_->IsEdgeTriggered()) {
+        channel_->SetEvents(channel_->GetEvents());
+    }
+}
+
+bool Connection::UseZeroCopy()
+{
+    size_t zerocopy_threshold = loop_->GetZeroCopyThreshold();
+    if (!zerocopy_threshold || zerocopy_unsupported_ || write_buffer_->GetLen() < zerocopy_threshold) {
+        return false;
+    }
+    if (!zerocopy_enabled_) {
+        int on = 1;
+        if (setsockopt(channel_->Getfd(), SOL_SOCKET, SO_ZEROCOPY, &on, sizeof(on)) != 0) {
+            IMAGINE_MUDUO_LOG("enable SO_ZEROCOPY exception, errno is %d", errno);
+            zerocopy_unsupported_ = true;
+            return false;
+        }
+        zerocopy_enabled_ = true;
+    }
+
+    return true;
+}
+
+void Connection::ReleaseZeroCopyBlocks()
+{
+    write_buffer_->Clear();
+    write_buffer_->ReapZeroCopy(channel_->Getfd());
+    if (!write_buffer_->GetPinnedBlockNum()) {
+        return;
+    }
+    // 关闭socket后无法再读取完成通知, 而内核可能仍在发送或重传这些数据块: 用dup出的fd保持socket及其错误队列, 先发送FIN, 收到全部完成通知后再关闭
+    int drain_fd = dup(channel_->Getfd());
+    if (drain_fd == -1) {
+        // 写缓冲区随连接析构, 仍被引用的数据块不会归还BlockPool
+        IMAGINE_MUDUO_LOG("dup socket for zerocopy drain exception, errno is %d", errno);
+        return;
+    }
+    shutdown(drain_fd, SHUT_WR);
+    std::shared_ptr<ChainBuffer> drain_buffer(write_buffer_);
+    write_buffer_ = new ChainBuffer();
+    loop_->SetTimer(std::bind(&Connection::DrainZeroCopy, loop_, drain_buffer, drain_fd, zerocopy_drain_timeout_ms_ / zerocopy_drain_interval_ms_), 0, zerocopy_drain_interval_ms_ / 1000.0);
+}
+
+void Connection::DrainZeroCopy(EventLoop* loop, std::shared_ptr<ChainBuffer> buffer, int fd, int remain_num)
+{
+    buffer->ReapZeroCopy(fd);
+    if (buffer->GetPinnedBlockNum() && remain_num > 0) {
+        loop->SetTimer(std::bind(&Connection::DrainZeroCopy, loop, buffer, fd, remain_num - 1), 0, zerocopy_drain_interval_ms_ / 1000.0);
+        return;
+    }
+    // 超时仍未完成的数据块随写缓冲区析构丢弃, 不会被复用后改写正在发送的数据
+    close(fd);
+}
+
+void Connection::Flush()
+{
+    if (!flush_queued_) {
+        return;
+    }
+    ProcessWrite();
+}
+
+void Connection::SetCork(bool on)
+{
+    int value = on ? 1 : 0;
+    if (setsockopt(channel_->Getfd(), IPPROTO_TCP, TCP_CORK, &value, sizeof(value)) != 0) {
+        IMAGINE_MUDUO_LOG("set TCP_CORK exception, errno is %d", errno);
+    }
+}
+
+bool Connection::WatchPipe(int pipe_fd)
+{
+    if (pipe_channel_) {
+        return true;
+    }
+    // Poller删除Channel时会关闭fd, 监听dup出的fd, 不影响管道本身(close_fd由写缓冲区负责)
+    int watch_fd = dup(pipe_fd);
+    if (watch_fd == -1) {
+        IMAGINE_MUDUO_LOG("dup pipe fd exception, errno is %d", errno);
+        return false;
+    }
+    pipe_channel_ = std::make_shared<Channel>();
+    pipe_channel_->MakeSelf(pipe_channel_);
+    pipe_channel_->SetLoop(loop_);
+    pipe_channel_->Setfd(watch_fd);
+    pipe_channel_->SetEventHandler(std::bind(&Connection::PipeHandler, this));
+    pipe_channel_->SetEvents(EPOLLIN | EPOLLONESHOT);
+    loop_->AddChannel(pipe_channel_);
+
+    return true;
+}
+
+void Connection::PipeHandler()
+{
+    if (!pipe_channel_) {
+        return;
+    }
+    // 管道可读(或写端已关闭)后撤销监听, 继续发送写缓冲区, 管道仍然没有数据时会重新注册
+    pipe_channel_->Close();
+    pipe_channel_.reset();
+    ProcessWrite();
+}
+
 void Connection::DefaultReadCallback(Connection* conn) const
 {
     return;
@@ -108,25 +429,95 @@ void Connection::DefaultWriteCallback(Connection* conn) const
     return;
 }
 
+void Connection::DefaultOverloadCallback(Connection* conn) const
+{
+    return;
+}
+
+void Connection::DefaultWriteCompleteCallback(Connection* conn) const
+{
+    return;
+}
+
+void Connection::DefaultHighWaterMarkCallback(Connection* conn) const
+{
+    conn->PauseRead();
+}
+
+void Connection::DefaultLowWaterMarkCallback(Connection* conn) const
+{
+    conn->ResumeRead();
+}
+
 void Connection::ProcessRead()
 {
-    do {
-        PackageCoalescingDetector();
-        read_callback_(this);
-        if (clear_read_buffer_) {
-            read_buffer_->Clear(msg_begin_idx_, msg_end_idx_);
-            IMAGINE_MUDUO_LOG("Clear read buffer from %d to %d, buffer size is %d", msg_begin_idx_, msg_end_idx_, read_buffer_->GetLen());
+    DynamicCodec codec;
+    DynamicHandler handler;
+    ProcessRead(codec, handler);
+}
+
+void Connection::ClearFrame()
+{
+    if (clear_read_buffer_) {
+        read_buffer_->Clear(msg_begin_idx_, frame_end_idx_);
+        IMAGINE_MUDUO_LOG("Clear read buffer from %d to %d, buffer size is %d", msg_begin_idx_, frame_end_idx_, read_buffer_->GetLen());
+    }
+}
+
+void Connection::CloseInvalidFrame()
+{
+    IMAGINE_MUDUO_LOG("invalid message frame, close connection");
+    server_->CloseConnection(GetPeerIp(), GetPeerPort());
+}
+
+void Connection::FinishRead(bool write_idle)
+{
+    if (write_idle && !write_buffer_->IsEmpty()) {
+        if (loop_->IsCoalesceOutput()) {
+            // 推迟到本轮就绪事件全部处理完后统一发送, 期间该连接产生的所有响应合并为一次写
+            if (!flush_queued_) {
+                flush_queued_ = true;
+                loop_->QueueFlush(this);
+            }
+            return;
         }
-    } while (get_next_msg_);
+        // 写缓冲区原本为空时直接尝试发送响应, 只有发送不完(EAGAIN)时才注册EPOLLOUT, 省去一次epoll唤醒及事件重新注册
+        ProcessWrite();
+        return;
+    }
     UpdateRevent();
 }
 
 void Connection::ProcessWrite()
 {
-    write_callback_(this);
-    write_buffer_->Write(channel_->Getfd());
-    if (clear_write_buffer_) {
-        write_buffer_->Clear();
+    // 继续发送上一次剩余的数据时不再调用写回调, 避免重复生成响应
+    if (!write_in_progress_) {
+        write_callback_(this);
+    }
+    flush_queued_ = false;
+    if (!write_buffer_->IsEmpty()) {
+        // 响应头与sendfile/splice的数据分多次系统调用写入, 用TCP_CORK合并成完整的报文
+        bool cork = loop_->IsTcpCork() && write_buffer_->GetFileLen();
+        if (cork) {
+            SetCork(true);
+        }
+        ssize_t write_len = write_buffer_->Write(channel_->Getfd(), UseZeroCopy());
+        if (cork) {
+            SetCork(false);
+        }
+        if (write_len < 0 || (write_buffer_->GetWaitingPipe() != -1 && !WatchPipe(write_buffer_->GetWaitingPipe()))) {
+            server_->CloseConnection(GetPeerIp(), GetPeerPort());
+            return;
+        }
+    }
+    // 未发送完的数据保留在写缓冲区中, 由UpdateRevent继续关注EPOLLOUT
+    write_in_progress_ = !write_buffer_->IsEmpty();
+    if (above_high_water_mark_ && write_buffer_->GetLen() <= loop_->GetLowWaterMark()) {
+        above_high_water_mark_ = false;
+        low_water_mark_callback_(this);
+    }
+    if (!write_in_progress_) {
+        write_complete_callback_(this);
     }
     UpdateRevent();
 }
@@ -135,6 +526,8 @@ Connection* const Connection::SetMessageFormatWithFixedLength(size_t msg_length,
 {
     msg_format_ = MessageFormat::FixedLenth;
     msg_length_ = msg_length;
+    searched_len_ = 0;
+    header_len_ = frame_len_ = 0;
     place_holder_ = place_holder;
 
     return this;
@@ -144,6 +537,53 @@ Connection* const Connection::SetMessageFormatWithSpecialEOF(std::string eof)
 {
     msg_format_ = MessageFormat::SpecialEOF;
     eof_ = eof;
+    searched_len_ = 0;
+    header_len_ = frame_len_ = 0;
+
+    return this;
+}
+
+Connection* const Connection::SetMessageFormatWithLengthPrefix(LengthField length_field, bool big_endian, size_t header_offset, size_t max_frame_len)
+{
+    msg_format_ = MessageFormat::LengthPrefixed;
+    length_field_ = length_field;
+    big_endian_ = big_endian;
+    header_offset_ = header_offset;
+    max_frame_len_ = max_frame_len;
+    header_len_ = frame_len_ = 0;
+
+    return this;
+}
+
+Connection* const Connection::SetMessageFormatWithHttp(size_t max_header_len, size_t max_body_len)
+{
+    msg_format_ = MessageFormat::Http;
+    searched_len_ = 0;
+    header_len_ = frame_len_ = 0;
+    get_next_msg_ = true;
+    if (http_parser_ == nullptr) {
+        http_parser_ = new HttpParser(max_header_len, max_body_len);
+    } else {
+        http_parser_->SetMaxHeaderLen(max_header_len)->SetMaxBodyLen(max_body_len);
+        http_parser_->Reset();
+    }
+
+    return this;
+}
+
+Connection* const Connection::SetMessageFormatWithWebSocket(size_t max_message_len)
+{
+    msg_format_ = MessageFormat::WebSocket;
+    searched_len_ = 0;
+    header_len_ = frame_len_ = 0;
+    get_next_msg_ = true;
+    ws_close_sent_ = false;
+    if (ws_parser_ == nullptr) {
+        ws_parser_ = new WebSocketParser(max_message_len);
+    } else {
+        ws_parser_->SetMaxMessageLen(max_message_len);
+        ws_parser_->Reset();
+    }
 
     return this;
 }
@@ -151,6 +591,8 @@ Connection* const Connection::SetMessageFormatWithSpecialEOF(std::string eof)
 Connection* const Connection::ClearMessageFormat()
 {
     msg_format_ = MessageFormat::None;
+    searched_len_ = 0;
+    header_len_ = frame_len_ = 0;
 
     return this;
 }
@@ -209,6 +651,57 @@ size_t Connection::GetMessageLen() const
     return msg_end_idx_ - msg_begin_idx_;
 }
 
+MessageView Connection::GetMessage() const
+{
+    return MessageView(read_buffer_->GetData() + msg_begin_idx_, msg_end_idx_ - msg_begin_idx_);
+}
+
+MessageView Connection::PinMessage()
+{
+    return MessageView(read_buffer_->GetData() + msg_begin_idx_, msg_end_idx_ - msg_begin_idx_, read_buffer_->Pin());
+}
+
+Connection* Connection::SetFrame(size_t msg_end_idx, size_t frame_end_idx, size_t header_len)
+{
+    if (msg_end_idx > frame_end_idx || frame_end_idx > read_buffer_->GetLen() || header_len > msg_end_idx) {
+        throw std::exception();
+    }
+    msg_begin_idx_ = 0;
+    msg_end_idx_ = msg_end_idx;
+    frame_end_idx_ = frame_end_idx;
+    header_len_ = header_len;
+
+    return this;
+}
+
+size_t Connection::GetHeaderLen() const
+{
+    return header_len_;
+}
+
+MessageView Connection::GetBody() const
+{
+    return MessageView(read_buffer_->GetData() + msg_begin_idx_ + header_len_, msg_end_idx_ - msg_begin_idx_ - header_len_);
+}
+
+const HttpRequest& Connection::GetHttpRequest() const
+{
+    if (http_parser_ == nullptr) {
+        throw std::exception();
+    }
+
+    return http_parser_->GetRequest();
+}
+
+const WebSocketMessage& Connection::GetWebSocketMessage() const
+{
+    if (ws_parser_ == nullptr) {
+        throw std::exception();
+    }
+
+    return ws_parser_->GetMessage();
+}
+
 const char* Connection::GetData() const
 {
     return read_buffer_->GetData();
@@ -222,6 +715,52 @@ size_t Connection::GetLen() const
 Connection* Connection::AppendData(const char* data, size_t len)
 {
     write_buffer_->append(data, len);
+    size_t high_water_mark = loop_->GetHighWaterMark();
+    if (high_water_mark && !above_high_water_mark_ && write_buffer_->GetLen() >= high_water_mark) {
+        above_high_water_mark_ = true;
+        high_water_mark_callback_(this);
+    }
+
+    return this;
+}
+
+Connection* Connection::SendFile(int fd, off_t offset, size_t len, bool close_fd)
+{
+    write_buffer_->AppendFile(fd, offset, len, close_fd);
+
+    return this;
+}
+
+Connection* Connection::SendPipe(int pipe_fd, size_t len, bool close_fd)
+{
+    write_buffer_->AppendPipe(pipe_fd, len, close_fd);
+
+    return this;
+}
+
+Connection* Connection::SendWebSocketFrame(WebSocketMessage::Opcode opcode, const char* data, size_t len, bool fin)
+{
+    char header[WebSocketParser::max_header_len_];
+    AppendData(header, WebSocketParser::EncodeHeader(header, opcode, len, fin));
+    if (len) {
+        AppendData(data, len);
+    }
+
+    return this;
+}
+
+Connection* Connection::SendWebSocketClose(uint16_t code, const std::string& reason)
+{
+    if (ws_close_sent_) {
+        return this;
+    }
+    std::string payload;
+    payload.push_back(static_cast<char>(code >> 8));
+    payload.push_back(static_cast<char>(code & 0xff));
+    // 控制帧负载不超过125字节
+    payload.append(reason, 0, 123);
+    SendWebSocketFrame(WebSocketMessage::Opcode::Close, payload.data(), payload.size());
+    ws_close_sent_ = true;
 
     return this;
 }
@@ -229,6 +768,14 @@ Connection* Connection::AppendData(const char* data, size_t len)
 Connection* Connection::ClearReadBuffer()
 {
     read_buffer_->Clear();
+    searched_len_ = 0;
+    header_len_ = frame_len_ = 0;
+    if (http_parser_ != nullptr) {
+        http_parser_->Reset();
+    }
+    if (ws_parser_ != nullptr) {
+        ws_parser_->Reset();
+    }
 
     return this;
 }
@@ -259,7 +806,7 @@ Connection* Connection::SetMessageEndIdx(size_t msg_end_idx)
     if (msg_end_idx < msg_begin_idx_ || read_buffer_->GetLen() < msg_end_idx) {
         throw std::exception();
     }
-    msg_end_idx_ = msg_end_idx;
+    msg_end_idx_ = frame_end_idx_ = msg_end_idx;
 
     return this;
 }
@@ -299,8 +846,64 @@ Connection* Connection::SetWriteCallback(ConnectionCallback write_callback)
     return this;
 }
 
+Connection* Connection::SetOverloadCallback(ConnectionCallback overload_callback)
+{
+    overload_callback_ = overload_callback;
+
+    return this;
+}
+
+Connection* Connection::SetWriteCompleteCallback(ConnectionCallback write_complete_callback)
+{
+    write_complete_callback_ = write_complete_callback;
+
+    return this;
+}
+
+Connection* Connection::SetHighWaterMarkCallback(ConnectionCallback high_water_mark_callback)
+{
+    high_water_mark_callback_ = high_water_mark_callback;
+
+    return this;
+}
+
+Connection* Connection::SetLowWaterMarkCallback(ConnectionCallback low_water_mark_callback)
+{
+    low_water_mark_callback_ = low_water_mark_callback;
+
+    return this;
+}
+
+Connection* Connection::PauseRead()
+{
+    read_paused_ = true;
+
+    return this;
+}
+
+Connection* Connection::ResumeRead()
+{
+    read_paused_ = false;
+
+    return this;
+}
+
+size_t Connection::GetPendingWriteLen() const
+{
+    return write_buffer_->GetLen() + write_buffer_->GetFileLen();
+}
+
 Connection* Connection::Close()
 {
+    loop_->RemoveIdleConnection(this);
+    flush_queued_ = false;
+    if (pipe_channel_) {
+        pipe_channel_->Close();
+        pipe_channel_.reset();
+    }
+    if (zerocopy_enabled_) {
+        ReleaseZeroCopyBlocks();
+    }
     channel_->Close();
 
     return nullptr;
@@ -321,28 +924,49 @@ Connection* Connection::Reset()
 Connection* Connection::ResetRecvTime()
 {
     recv_time.SetTime(NOW_MS);
+    loop_->TouchConnection(this);
 
     return this;
 }
 
 Connection* Connection::UpdateRevent()
 {
-    if (!keep_alive_) {
-        server_->CloseConnection(ip_, port_);
+    // 还有待发送的数据时总是继续关注EPOLLOUT; 不再保持连接时等数据发送完毕再关闭
+    bool write_pending = !write_buffer_->IsEmpty();
+    if ((!keep_alive_ && !write_pending) || next_event_ == Event::ReadAndWrite) {
+        server_->CloseConnection(GetPeerIp(), GetPeerPort());
         return this;
     }
-    switch (next_event_) {
-        case Event::Read:
-            channel_->SetEvents(EPOLLIN | EPOLLONESHOT | EPOLLRDHUP);
-            break;
-        case Event::Write:
-            channel_->SetEvents(EPOLLOUT | EPOLLONESHOT | EPOLLRDHUP);
-            break;
-        default:
-            server_->CloseConnection(ip_, port_);
-            break;
+    // 等待管道数据时socket仍然可写, 关注EPOLLOUT会不断唤醒(或在边沿触发模式下错过管道就绪), 改由pipe_channel_恢复发送
+    bool pipe_waiting = pipe_channel_.get() != nullptr;
+    bool want_write = (write_pending && !pipe_waiting) || (keep_alive_ && next_event_ == Event::Write);
+    bool want_read = keep_alive_ && !read_paused_;
+    if (loop_->IsEdgeTriggered()) {
+        // 边沿触发模式下连接只注册一次, 只有关注的事件变化时才修改(epoll_ctl)
+        int events = EPOLLRDHUP | EPOLLET;
+        if (want_read) {
+            events |= EPOLLIN;
+        }
+        if (want_write) {
+            events |= EPOLLOUT;
+        }
+        if (channel_->GetEvents() != events) {
+            channel_->SetEvents(events);
+        }
+        return this;
     }
-    
+    if (pipe_waiting) {
+        // EPOLLONESHOT模式下socket保持未注册状态, 避免与pipe_channel_的事件被不同线程同时处理
+        return this;
+    }
+    if (want_write) {
+        channel_->SetEvents(EPOLLOUT | EPOLLONESHOT | EPOLLRDHUP);
+    } else if (want_read) {
+        channel_->SetEvents(EPOLLIN | EPOLLONESHOT | EPOLLRDHUP);
+    } else {
+        channel_->SetEvents(EPOLLONESHOT | EPOLLRDHUP);
+    }
+
     return this;
 }
 
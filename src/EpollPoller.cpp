@@ -4,44 +4,58 @@
 #include "Imagine_Muduo/EventLoop.h"
 #include "Imagine_Muduo/Channel.h"
 
+#include <algorithm>
+
 namespace Imagine_Muduo
 {
 
-EpollPoller::EpollPoller(const EventLoop *loop) : Poller()
+static uint64_t MakeEventData(int fd, uint32_t generation)
 {
-    loop_ = loop;
-    channel_num_ = 0;
-    epollfd_ = epoll_create(100);
+    return (static_cast<uint64_t>(generation) << 32) | static_cast<uint32_t>(fd);
+}
 
-    hashmap_lock_ = new pthread_mutex_t;
-    if (pthread_mutex_init(hashmap_lock_, nullptr) != 0) {
+EpollPoller::EpollPoller(const EventLoop *loop, size_t batch_size) : Poller(), events_(batch_size > 0 ? batch_size : 1), loop_(loop)
+{
+    epollfd_ = epoll_create1(EPOLL_CLOEXEC);
+    if (epollfd_ < 0) {
         throw std::exception();
     }
+
+    if (pthread_mutex_init(&channels_lock_, nullptr) != 0) {
+        throw std::exception();
+    }
+}
+
+EpollPoller::~EpollPoller()
+{
+    close(epollfd_);
+    pthread_mutex_destroy(&channels_lock_);
 }
 
 Poller* EpollPoller::poll(int timeoutMs, std::vector<std::shared_ptr<Channel>>& active_channels)
 {
-    epoll_event *events_set = new epoll_event[channel_num_];
-    int events_num = epoll_wait(epollfd_, events_set, channel_num_, timeoutMs);
+    int events_num = epoll_wait(epollfd_, &events_[0], static_cast<int>(events_.size()), timeoutMs);
     IMAGINE_MUDUO_LOG("stop waiting...");
-    if (events_num < 0 || errno == EINTR) {
+    if (events_num < 0) {
+        if (errno == EINTR) {
+            return this;
+        }
         IMAGINE_MUDUO_LOG("poll exception!");
         throw std::exception();
     }
 
+    pthread_mutex_lock(&channels_lock_);
     for (int i = 0; i < events_num; i++) {
-        pthread_mutex_lock(hashmap_lock_);
-        std::shared_ptr<Channel> temp_channel = channels_.find(events_set[i].data.fd)->second;
-        pthread_mutex_unlock(hashmap_lock_);
-        if (!temp_channel) {
-            IMAGINE_MUDUO_LOG("poll exception!2");
-            throw std::exception();
+        int fd = static_cast<int>(events_[i].data.u64 & 0xffffffff);
+        uint32_t generation = static_cast<uint32_t>(events_[i].data.u64 >> 32);
+        if (static_cast<size_t>(fd) >= channels_.size() || channels_[fd].generation_ != generation || !channels_[fd].channel_) {
+            // fd已被删除或已被复用, 丢弃过期事件
+            continue;
         }
-        temp_channel->SetRevents(events_set[i].events);
-        active_channels.push_back(temp_channel);
+        channels_[fd].channel_->SetRevents(events_[i].events);
+        active_channels.push_back(channels_[fd].channel_);
     }
-
-    delete[] events_set;
+    pthread_mutex_unlock(&channels_lock_);
 
     return this;
 }
@@ -49,13 +63,17 @@ Poller* EpollPoller::poll(int timeoutMs, std::vector<std::shared_ptr<Channel>>&
 Poller* EpollPoller::AddChannel(const std::shared_ptr<Channel>& channel)
 {
     int fd = channel->Getfd();
-    pthread_mutex_lock(hashmap_lock_);
-    channels_.insert(std::make_pair(fd, channel));
-    pthread_mutex_unlock(hashmap_lock_);
-    channel_num_++;
+    pthread_mutex_lock(&channels_lock_);
+    if (static_cast<size_t>(fd) >= channels_.size()) {
+        channels_.resize(std::max(static_cast<size_t>(fd) + 1, channels_.size() * 2));
+    }
+    ChannelSlot& slot = channels_[fd];
+    slot.channel_ = channel;
+    slot.generation_++;
     epoll_event e_event;
-    e_event.data.fd = fd;
+    e_event.data.u64 = MakeEventData(fd, slot.generation_);
     e_event.events = channel->GetEvents();
+    pthread_mutex_unlock(&channels_lock_);
     epoll_ctl(epollfd_, EPOLL_CTL_ADD, fd, &e_event);
 
     return this;
@@ -63,9 +81,16 @@ Poller* EpollPoller::AddChannel(const std::shared_ptr<Channel>& channel)
 
 const Poller* EpollPoller::Update(int fd, int events) const
 {
+    pthread_mutex_lock(&channels_lock_);
+    if (static_cast<size_t>(fd) >= channels_.size() || !channels_[fd].channel_) {
+        // 尚未加入Poller的Channel
+        pthread_mutex_unlock(&channels_lock_);
+        return this;
+    }
     epoll_event e_event;
-    e_event.data.fd = fd;
+    e_event.data.u64 = MakeEventData(fd, channels_[fd].generation_);
     e_event.events = events;
+    pthread_mutex_unlock(&channels_lock_);
     epoll_ctl(epollfd_, EPOLL_CTL_MOD, fd, &e_event);
 
     return this;
@@ -74,10 +99,12 @@ const Poller* EpollPoller::Update(int fd, int events) const
 Poller* EpollPoller::DelChannel(const std::shared_ptr<Channel>& channel)
 {
     int fd = channel->Getfd();
-    pthread_mutex_lock(hashmap_lock_);
-    channels_.erase(fd);
-    pthread_mutex_unlock(hashmap_lock_);
-    channel_num_--;
+    pthread_mutex_lock(&channels_lock_);
+    if (static_cast<size_t>(fd) < channels_.size()) {
+        channels_[fd].channel_.reset();
+        channels_[fd].generation_++;
+    }
+    pthread_mutex_unlock(&channels_lock_);
     epoll_ctl(epollfd_, EPOLL_CTL_DEL, fd, NULL);
     close(fd);
 
@@ -86,18 +113,17 @@ Poller* EpollPoller::DelChannel(const std::shared_ptr<Channel>& channel)
 
 std::shared_ptr<Channel> EpollPoller::FindChannel(int fd) const
 {
-    pthread_mutex_lock(hashmap_lock_);
-    std::unordered_map<int, std::shared_ptr<Channel>>::const_iterator it = channels_.find(fd);
     std::shared_ptr<Channel> temp_channel;
-    if (it == channels_.end()) {
+    pthread_mutex_lock(&channels_lock_);
+    if (static_cast<size_t>(fd) >= channels_.size() || !channels_[fd].channel_) {
         // 重复删除
         IMAGINE_MUDUO_LOG("delete already!");
     } else {
-        temp_channel = it->second;
+        temp_channel = channels_[fd].channel_;
     }
-    pthread_mutex_unlock(hashmap_lock_);
+    pthread_mutex_unlock(&channels_lock_);
 
     return temp_channel;
 }
 
-} // namespace Imagine_Muduo
\ No newline at end of file
+} // namespace Imagine_Muduo
@@ -3,16 +3,27 @@
 #include "Imagine_Muduo/log_macro.h"
 #include "Imagine_Muduo/Channel.h"
 #include "Imagine_Muduo/EpollPoller.h"
+#include "Imagine_Muduo/IoUringPoller.h"
 #include "Imagine_Muduo/ThreadPool.h"
+#include "Imagine_Muduo/TimingWheel.h"
+#include "Imagine_Muduo/Connection.h"
+#include "Imagine_Muduo/Server.h"
+#include "Imagine_Muduo/BlockPool.h"
 
 #include <memory>
 #include <fstream>
+#include <cstring>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
 
 namespace Imagine_Muduo
 {
 
 EventLoop::EventLoop()
-            : quit_(0), channel_num_(0), epoll_(new EpollPoller(this)), timer_channel_(Channel::Create(this, 0, Channel::ChannelTyep::TimerChannel))
+            : multi_reactor_(false), loop_num_(0), dispatch_policy_(DispatchPolicy::RoundRobin), sharded_accept_(false), overload_policy_(OverloadPolicy::Block), poller_type_(PollerType::Epoll), poll_batch_size_(1024), edge_triggered_(false), idle_timeout_(0), high_water_mark_(0), low_water_mark_(0), zerocopy_threshold_(0), coalesce_output_(false), tcp_cork_(false), quit_(0), thread_pool_(nullptr), channel_num_(0),
+              main_loop_(nullptr), sub_loop_threads_(nullptr), next_loop_idx_(0), looping_(false), epoll_(new EpollPoller(this)),
+              timer_channel_(Channel::Create(this, 0, Channel::ChannelTyep::TimerChannel)), timing_wheel_(new TimingWheel()), next_timer_id_(0), armed_expire_(-1), wakeup_channel_(Channel::Create(this, 0, Channel::ChannelTyep::WakeupChannel)),
+              calling_pending_functors_(false)
 {
 }
 
@@ -26,10 +37,20 @@ EventLoop::EventLoop(const YAML::Node& config) : EventLoop()
     Init(config);
 }
 
+EventLoop::EventLoop(const EventLoop* main_loop) : EventLoop()
+{
+    InitSubLoop(main_loop);
+}
+
 EventLoop::~EventLoop()
 {
+    for (size_t i = 0; i < sub_loops_.size(); i++) {
+        delete sub_loops_[i];
+    }
+    delete[] sub_loop_threads_;
     delete thread_pool_;
     delete epoll_;
+    delete timing_wheel_;
 }
 
 void EventLoop::Init(const std::string& profile_name)
@@ -47,6 +68,47 @@ void EventLoop::Init(const YAML::Node& config)
     thread_num_ = config["thread_num"].as<size_t>();
     max_channel_num_ = config["max_channel_num"].as<size_t>();
     singleton_log_mode_ = config["singleton_log_mode"].as<bool>();
+    multi_reactor_ = config["multi_reactor"].as<bool>(false);
+    loop_num_ = config["loop_num"].as<size_t>(thread_num_);
+    std::string dispatch_policy = config["loop_dispatch_policy"].as<std::string>("round_robin");
+    if (dispatch_policy == "round_robin") {
+        dispatch_policy_ = DispatchPolicy::RoundRobin;
+    } else if (dispatch_policy == "least_loaded") {
+        dispatch_policy_ = DispatchPolicy::LeastLoaded;
+    } else {
+        throw std::exception();
+    }
+    sharded_accept_ = config["sharded_accept"].as<bool>(false);
+    std::string poller_type = config["poller"].as<std::string>("epoll");
+    if (poller_type == "epoll") {
+        poller_type_ = PollerType::Epoll;
+    } else if (poller_type == "io_uring") {
+        poller_type_ = PollerType::IoUring;
+    } else {
+        throw std::exception();
+    }
+    poll_batch_size_ = config["poll_batch_size"].as<size_t>(1024);
+    edge_triggered_ = config["edge_triggered"].as<bool>(false);
+    idle_timeout_ = config["idle_timeout"].as<size_t>(0);
+    high_water_mark_ = config["high_water_mark"].as<size_t>(64 * 1024 * 1024);
+    low_water_mark_ = config["low_water_mark"].as<size_t>(16 * 1024 * 1024);
+    if (low_water_mark_ > high_water_mark_) {
+        throw std::exception();
+    }
+    zerocopy_threshold_ = config["zerocopy_threshold"].as<size_t>(0);
+    coalesce_output_ = config["coalesce_output"].as<bool>(false);
+    tcp_cork_ = config["tcp_cork"].as<bool>(false);
+    BlockPool::SetWatermark(config["buffer_pool_high_watermark"].as<size_t>(1024), config["buffer_pool_low_watermark"].as<size_t>(256));
+    std::string overload_policy = config["overload_policy"].as<std::string>("block");
+    if (overload_policy == "block") {
+        overload_policy_ = OverloadPolicy::Block;
+    } else if (overload_policy == "reject") {
+        overload_policy_ = OverloadPolicy::Reject;
+    } else if (overload_policy == "shed_oldest") {
+        overload_policy_ = OverloadPolicy::ShedOldest;
+    } else {
+        throw std::exception();
+    }
 
     if (singleton_log_mode_) {
         logger_ = SingletonLogger::GetInstance();
@@ -57,46 +119,304 @@ void EventLoop::Init(const YAML::Node& config)
 
     logger_->Init(config);
 
+    if (sharded_accept_ && (!multi_reactor_ || loop_num_ == 0)) {
+        IMAGINE_MUDUO_LOG("sharded_accept requires multi_reactor with loop_num > 0, fallback to single listen channel");
+        sharded_accept_ = false;
+    }
+
+    if (edge_triggered_ && !multi_reactor_) {
+        // 线程池模式下同一连接的事件可能被多个worker同时处理, 必须依赖EPOLLONESHOT
+        IMAGINE_MUDUO_LOG("edge_triggered requires multi_reactor, fallback to EPOLLONESHOT");
+        edge_triggered_ = false;
+    }
+
+    if (coalesce_output_ && !multi_reactor_) {
+        // 线程池模式下读事件在worker线程上处理, 无法在loop线程的本轮末尾统一发送
+        IMAGINE_MUDUO_LOG("coalesce_output requires multi_reactor, fallback to direct write");
+        coalesce_output_ = false;
+    }
+
     InitLoop();
 }
 
+void EventLoop::InitPoller()
+{
+    // 构造函数中默认创建的EpollPoller此时还没有任何Channel加入, 可以按配置直接替换
+    if (poller_type_ == PollerType::IoUring && !IoUringPoller::IsSupported()) {
+        IMAGINE_MUDUO_LOG("io_uring is not supported by the kernel, fallback to epoll");
+        poller_type_ = PollerType::Epoll;
+    }
+    delete epoll_;
+    if (poller_type_ == PollerType::IoUring) {
+        epoll_ = new IoUringPoller(this);
+    } else {
+        epoll_ = new EpollPoller(this, poll_batch_size_);
+    }
+}
+
 void EventLoop::InitLoop()
 {
-    listen_channel_ = Channel::Create(this, port_, Channel::ChannelTyep::ListenChannel);
+    InitPoller();
+    if (!sharded_accept_) {
+        listen_channel_ = Channel::Create(this, port_, Channel::ChannelTyep::ListenChannel);
+    }
 
-    try {
-        thread_pool_ = new ThreadPool<std::shared_ptr<Channel>>(thread_num_, max_channel_num_); // 初始化线程池
-    } catch (...) {
-        throw std::exception();
+    if (multi_reactor_) {
+        // 每个从Reactor在自己的线程上独占一个EpollPoller, 连接的所有I/O都在其所属的线程上完成
+        for (size_t i = 0; i < loop_num_; i++) {
+            sub_loops_.push_back(new EventLoop(this));
+        }
+    } else {
+        try {
+            thread_pool_ = new ThreadPool<std::shared_ptr<Channel>>(thread_num_, max_channel_num_, overload_policy_); // 初始化线程池
+        } catch (...) {
+            throw std::exception();
+        }
+        thread_pool_->SetRejectHandler(std::bind(&Channel::HandleOverload, std::placeholders::_1));
     }
 
-    if (pthread_mutex_init(&timer_lock_, nullptr) != 0) {
-        throw std::exception();
+    epoll_->AddChannel(timer_channel_);
+    epoll_->AddChannel(wakeup_channel_);
+    if (listen_channel_) {
+        epoll_->AddChannel(listen_channel_); // 创建监听套接字并添加到epoll
     }
 
-    if (pthread_mutex_init(&timer_map_lock_, nullptr) != 0) {
-        throw std::exception();
+    // 多Reactor模式下主Reactor不持有连接, 空闲检测由各个从Reactor各自完成
+    if (idle_timeout_ && !multi_reactor_) {
+        SetTimer(std::bind(&EventLoop::CloseIdleConnections, this), 1.0);
+    }
+}
+
+void EventLoop::InitSubLoop(const EventLoop* main_loop)
+{
+    main_loop_ = main_loop;
+    thread_num_ = 0;
+    max_channel_num_ = main_loop->max_channel_num_;
+    port_ = main_loop->port_;
+    singleton_log_mode_ = main_loop->singleton_log_mode_;
+    logger_ = main_loop->logger_;
+    multi_reactor_ = true;
+    loop_num_ = 0;
+    dispatch_policy_ = main_loop->dispatch_policy_;
+    sharded_accept_ = main_loop->sharded_accept_;
+    overload_policy_ = main_loop->overload_policy_;
+    poller_type_ = main_loop->poller_type_;
+    poll_batch_size_ = main_loop->poll_batch_size_;
+    edge_triggered_ = main_loop->edge_triggered_;
+    idle_timeout_ = main_loop->idle_timeout_;
+    high_water_mark_ = main_loop->high_water_mark_;
+    low_water_mark_ = main_loop->low_water_mark_;
+    zerocopy_threshold_ = main_loop->zerocopy_threshold_;
+    coalesce_output_ = main_loop->coalesce_output_;
+    tcp_cork_ = main_loop->tcp_cork_;
+    InitPoller();
+    if (sharded_accept_) {
+        // 每个从Reactor绑定自己的监听socket, 由内核通过SO_REUSEPORT把SYN分散到各个线程
+        listen_channel_ = Channel::Create(this, port_, Channel::ChannelTyep::ListenChannel);
     }
 
     epoll_->AddChannel(timer_channel_);
-    epoll_->AddChannel(listen_channel_); // 创建监听套接字并添加到epoll
+    epoll_->AddChannel(wakeup_channel_);
+    if (listen_channel_) {
+        epoll_->AddChannel(listen_channel_);
+    }
+
+    if (idle_timeout_) {
+        SetTimer(std::bind(&EventLoop::CloseIdleConnections, this), 1.0);
+    }
+}
+
+void EventLoop::StartSubLoops()
+{
+    if (sub_loops_.empty() || sub_loop_threads_ != nullptr) {
+        return;
+    }
+    sub_loop_threads_ = new pthread_t[sub_loops_.size()];
+    for (size_t i = 0; i < sub_loops_.size(); i++) {
+        IMAGINE_MUDUO_LOG("create sub loop %d ...", i);
+        if (pthread_create(sub_loop_threads_ + i, nullptr, [](void *argv) -> void *
+            {
+                EventLoop* sub_loop = (EventLoop*)argv;
+                sub_loop->loop();
+
+                return nullptr;
+            }, sub_loops_[i]) != 0) {
+            IMAGINE_MUDUO_LOG("sub loop exception!");
+            throw std::exception();
+        }
+
+        if (pthread_detach(*(sub_loop_threads_ + i))) {
+            IMAGINE_MUDUO_LOG("sub loop detach exception!");
+            throw std::exception();
+        }
+    }
 }
 
 void EventLoop::loop()
 {
+    thread_id_ = pthread_self();
+    looping_ = true;
+    StartSubLoops();
     while (!quit_) {
         std::vector<std::shared_ptr<Channel>> active_channels;
         epoll_->poll(-1, active_channels);
         while (active_channels.size()) {
-            thread_pool_->PutTask(active_channels[active_channels.size() - 1]);
+            // wakeup_channel_与timer_channel_总是在loop线程上直接处理
+            if (multi_reactor_ || active_channels[active_channels.size() - 1] == wakeup_channel_ || active_channels[active_channels.size() - 1] == timer_channel_) {
+                active_channels[active_channels.size() - 1]->HandleEvent();
+            } else {
+                thread_pool_->PutTask(active_channels[active_channels.size() - 1]);
+            }
             active_channels.pop_back();
         }
+        FlushPendingConnections();
+        DoPendingFunctors();
+    }
+}
+
+bool EventLoop::IsInLoopThread() const
+{
+    return looping_ && pthread_equal(thread_id_, pthread_self());
+}
+
+void EventLoop::RunInLoop(Functor functor)
+{
+    if (IsInLoopThread()) {
+        functor();
+    } else {
+        QueueInLoop(std::move(functor));
+    }
+}
+
+void EventLoop::QueueInLoop(Functor functor)
+{
+    {
+        std::unique_lock<std::mutex> lock(functor_lock_);
+        pending_functors_.push_back(std::move(functor));
+    }
+
+    // loop线程正在执行pending_functors_时新加入的任务要等到下一轮, 同样需要唤醒
+    if (!IsInLoopThread() || calling_pending_functors_) {
+        Wakeup();
     }
 }
 
+void EventLoop::Wakeup()
+{
+    if (eventfd_write(wakeup_channel_->Getfd(), 1) != 0) {
+        IMAGINE_MUDUO_LOG("wakeup loop exception!");
+    }
+}
+
+void EventLoop::DoPendingFunctors()
+{
+    std::vector<Functor> functors;
+    calling_pending_functors_ = true;
+    {
+        // 一次性交换出所有任务, 执行任务时不持有锁
+        std::unique_lock<std::mutex> lock(functor_lock_);
+        functors.swap(pending_functors_);
+    }
+    for (size_t i = 0; i < functors.size(); i++) {
+        functors[i]();
+    }
+    calling_pending_functors_ = false;
+}
+
 int EventLoop::GetChannelnum() const
 {
-    return channel_num_;
+    int channel_num = channel_num_;
+    for (size_t i = 0; i < sub_loops_.size(); i++) {
+        channel_num += sub_loops_[i]->GetChannelnum();
+    }
+
+    return channel_num;
+}
+
+int EventLoop::GetTotalChannelnum() const
+{
+    if (main_loop_ != nullptr) {
+        return main_loop_->GetChannelnum();
+    }
+
+    return GetChannelnum();
+}
+
+bool EventLoop::IsMultiReactor() const
+{
+    return multi_reactor_;
+}
+
+bool EventLoop::IsEdgeTriggered() const
+{
+    return edge_triggered_;
+}
+
+size_t EventLoop::GetHighWaterMark() const
+{
+    return high_water_mark_;
+}
+
+size_t EventLoop::GetLowWaterMark() const
+{
+    return low_water_mark_;
+}
+
+size_t EventLoop::GetZeroCopyThreshold() const
+{
+    return zerocopy_threshold_;
+}
+
+bool EventLoop::IsCoalesceOutput() const
+{
+    return coalesce_output_;
+}
+
+bool EventLoop::IsTcpCork() const
+{
+    return tcp_cork_;
+}
+
+EventLoop* EventLoop::QueueFlush(Connection* conn)
+{
+    pending_flush_.push_back(std::make_pair(conn->channel_, conn));
+
+    return this;
+}
+
+void EventLoop::FlushPendingConnections()
+{
+    if (pending_flush_.empty()) {
+        return;
+    }
+    std::vector<std::pair<std::shared_ptr<Channel>, Connection*>> flush_list;
+    flush_list.swap(pending_flush_);
+    for (size_t i = 0; i < flush_list.size(); i++) {
+        flush_list[i].second->Flush();
+    }
+}
+
+EventLoop* EventLoop::GetNextLoop()
+{
+    if (sub_loops_.empty()) {
+        return this;
+    }
+
+    if (dispatch_policy_ == DispatchPolicy::LeastLoaded) {
+        EventLoop* next_loop = sub_loops_[0];
+        int min_channel_num = next_loop->GetChannelnum();
+        for (size_t i = 1; i < sub_loops_.size(); i++) {
+            int channel_num = sub_loops_[i]->GetChannelnum();
+            if (channel_num < min_channel_num) {
+                min_channel_num = channel_num;
+                next_loop = sub_loops_[i];
+            }
+        }
+
+        return next_loop;
+    }
+
+    return sub_loops_[next_loop_idx_++ % sub_loops_.size()];
 }
 
 EventLoop* EventLoop::AddListenChannel(const std::string& port)
@@ -132,6 +452,20 @@ std::shared_ptr<Channel> EventLoop::GetListenChannel() const
     return listen_channel_;
 }
 
+std::vector<std::shared_ptr<Channel>> EventLoop::GetListenChannels() const
+{
+    std::vector<std::shared_ptr<Channel>> listen_channels;
+    if (listen_channel_) {
+        listen_channels.push_back(listen_channel_);
+    }
+    for (size_t i = 0; i < sub_loops_.size(); i++) {
+        std::vector<std::shared_ptr<Channel>> sub_listen_channels = sub_loops_[i]->GetListenChannels();
+        listen_channels.insert(listen_channels.end(), sub_listen_channels.begin(), sub_listen_channels.end());
+    }
+
+    return listen_channels;
+}
+
 int EventLoop::GetMaxchannelnum() const
 {
     return max_channel_num_;
@@ -175,68 +509,118 @@ long long EventLoop::SetTimer(TimerCallback timer_callback, double interval, dou
     if (interval == 0 && delay == 0) {
         return false;
     }
-    TimeStamp new_time;
-    if (delay) {
-        new_time.SetTime(TimeUtil::MicroSecondsAddSeconds(TimeUtil::GetNow(), delay));
-    } else {
-        new_time.SetTime(TimeUtil::MicroSecondsAddSeconds(TimeUtil::GetNow(), interval));
-    }
-    Timer *new_timer = new Timer(new_time, timer_callback, interval);
-    InsertTimer(new_timer);
-
-    return new_timer->GetTimerId();
+    long long timer_id = ++next_timer_id_;
+    long long delay_ms = static_cast<long long>((delay ? delay : interval) * 1000);
+    long long interval_ms = static_cast<long long>(interval * 1000);
+    RunInLoop([this, timer_id, timer_callback, delay_ms, interval_ms]()
+    {
+        timing_wheel_->AddTimer(timer_id, timer_callback, delay_ms, interval_ms);
+        ResetTimerfd();
+    });
+
+    return timer_id;
 }
 
 EventLoop* EventLoop::CloseTimer(long long timer_id)
 {
-    pthread_mutex_lock(&timer_map_lock_);
-    std::unordered_map<long long, Timer *>::iterator it = timer_map_.find(timer_id);
-    if (it == timer_map_.end()) {
-        pthread_mutex_unlock(&timer_map_lock_);
-        return this;
-    }
-    it->second->Close();
-    timer_map_.erase(it);
+    RunInLoop([this, timer_id]()
+    {
+        timing_wheel_->CancelTimer(timer_id);
+    });
 
     return this;
 }
 
-EventLoop* EventLoop::InsertTimer(Timer *timer)
+void EventLoop::HandleTimers()
+{
+    timing_wheel_->Advance(TimingWheel::GetNowMs());
+    armed_expire_ = -1;
+    ResetTimerfd();
+}
+
+void EventLoop::ResetTimerfd()
 {
-    pthread_mutex_lock(&timer_lock_);
-    timers_.push(timer);
-    if (timers_.top() == timer) {
-        TimeUtil::ResetTimerfd(timer_channel_->Getfd(), timers_.top()->GetCallTime());
+    long long next_expire = timing_wheel_->GetNextExpire();
+    // timerfd已经会在更早的时刻触发, 到时候再按时间轮的状态重新设置
+    if (next_expire == -1 || (armed_expire_ != -1 && armed_expire_ <= next_expire)) {
+        return;
     }
-    pthread_mutex_lock(&timer_map_lock_);
-    if (timer_map_.find(timer->GetTimerId()) == timer_map_.end()) {
-        timer_map_.insert(std::make_pair(timer->GetTimerId(), timer));
+    struct itimerspec new_value;
+    memset(&new_value, 0, sizeof(new_value));
+    new_value.it_value.tv_sec = next_expire / 1000;
+    new_value.it_value.tv_nsec = (next_expire % 1000) * 1000000;
+    if (timerfd_settime(timer_channel_->Getfd(), TFD_TIMER_ABSTIME, &new_value, nullptr) != 0) {
+        IMAGINE_MUDUO_LOG("timerfd settime exception!");
+        throw std::exception();
     }
-    pthread_mutex_unlock(&timer_map_lock_);
-    pthread_mutex_unlock(&timer_lock_);
-
-    return this;
+    armed_expire_ = next_expire;
 }
 
-std::vector<Timer *> EventLoop::GetExpiredTimers(const TimeStamp &now)
+void EventLoop::TouchConnection(Connection* conn)
 {
-    std::vector<Timer *> expired_timers;
-    pthread_mutex_lock(&timer_lock_);
-    Timer *top_timer = timers_.top();
-    // 比较绝对时间
-    while (timers_.size() && (top_timer->GetCallTime().GetTime()) < (now.GetTime())) {
-        expired_timers.push_back(top_timer);
-        timers_.pop();
-        top_timer = timers_.top();
+    if (!idle_timeout_) {
+        return;
+    }
+    std::unique_lock<std::mutex> lock(idle_lock_);
+    if (conn->idle_closed_) {
+        // 连接已被关闭(如被空闲检测关闭时线程池中仍在处理该连接), 不能重新加入链表
+        return;
     }
-    if (timers_.size()) {
-        TimeUtil::ResetTimerfd(timer_channel_->Getfd(), timers_.top()->GetCallTime());
+    conn->active_time_ = TimingWheel::GetNowMs();
+    if (conn->idle_linked_) {
+        idle_list_.splice(idle_list_.end(), idle_list_, conn->idle_it_);
     } else {
-        TimeUtil::SetDefaultTimerfd(timer_channel_->Getfd());
+        conn->idle_it_ = idle_list_.insert(idle_list_.end(), conn);
+        conn->idle_linked_ = true;
     }
-    pthread_mutex_unlock(&timer_lock_);
+}
 
-    return expired_timers;
+void EventLoop::RemoveIdleConnection(Connection* conn)
+{
+    if (!idle_timeout_) {
+        return;
+    }
+    std::unique_lock<std::mutex> lock(idle_lock_);
+    conn->idle_closed_ = true;
+    if (conn->idle_linked_) {
+        idle_list_.erase(conn->idle_it_);
+        conn->idle_linked_ = false;
+    }
+}
+
+void EventLoop::CloseIdleConnections()
+{
+    struct IdleConnection
+    {
+        Server* server_;
+        std::string ip_;
+        std::string port_;
+    };
+    std::vector<IdleConnection> idle_conns;
+    long long expire = TimingWheel::GetNowMs() - static_cast<long long>(idle_timeout_) * 1000;
+    {
+        // 链表按活跃时间有序, 只需从头部取出超时的连接; 仍在链表中的连接尚未Close, 可以安全访问
+        std::unique_lock<std::mutex> lock(idle_lock_);
+        while (!idle_list_.empty() && idle_list_.front()->active_time_ <= expire) {
+            Connection* conn = idle_list_.front();
+            idle_list_.pop_front();
+            conn->idle_linked_ = false;
+            IdleConnection idle_conn = {conn->GetServer(), conn->GetPeerIp(), conn->GetPeerPort()};
+            idle_conns.push_back(idle_conn);
+        }
+    }
+    // 关闭连接时会再次获取idle_lock_, 不能在持有锁时调用
+    for (size_t i = 0; i < idle_conns.size(); i++) {
+        IMAGINE_MUDUO_LOG("close idle connection %s:%s", idle_conns[i].ip_.c_str(), idle_conns[i].port_.c_str());
+        if (idle_conns[i].server_ != nullptr) {
+            idle_conns[i].server_->CloseConnection(idle_conns[i].ip_, idle_conns[i].port_);
+        }
+    }
+}
+
+const ThreadPool<std::shared_ptr<Channel>>* EventLoop::GetThreadPool() const
+{
+    return thread_pool_;
 }
 
 } // namespace Imagine_Muduo
\ No newline at end of file
@@ -0,0 +1,425 @@
+#include "Imagine_Muduo/HttpParser.h"
+
+#include "Imagine_Muduo/SimdSearch.h"
+
+#include <cstring>
+
+namespace Imagine_Muduo
+{
+
+HttpRequest::HttpRequest() : minor_version_(1), chunked_(false), keep_alive_(true)
+{
+}
+
+StringView HttpRequest::GetMethod() const
+{
+    return method_;
+}
+
+StringView HttpRequest::GetTarget() const
+{
+    return target_;
+}
+
+StringView HttpRequest::GetPath() const
+{
+    size_t query_idx = target_.Find('?');
+
+    return query_idx == StringView::npos ? target_ : target_.Substr(0, query_idx);
+}
+
+StringView HttpRequest::GetQuery() const
+{
+    size_t query_idx = target_.Find('?');
+
+    return query_idx == StringView::npos ? StringView() : target_.Substr(query_idx + 1);
+}
+
+int HttpRequest::GetMinorVersion() const
+{
+    return minor_version_;
+}
+
+size_t HttpRequest::GetHeaderNum() const
+{
+    return headers_.size();
+}
+
+StringView HttpRequest::GetHeaderName(size_t idx) const
+{
+    return headers_[idx].first;
+}
+
+StringView HttpRequest::GetHeaderValue(size_t idx) const
+{
+    return headers_[idx].second;
+}
+
+StringView HttpRequest::GetHeader(const StringView& name) const
+{
+    for (size_t i = 0; i < headers_.size(); i++) {
+        if (headers_[i].first.EqualsIgnoreCase(name)) {
+            return headers_[i].second;
+        }
+    }
+
+    return StringView();
+}
+
+bool HttpRequest::HasHeader(const StringView& name) const
+{
+    for (size_t i = 0; i < headers_.size(); i++) {
+        if (headers_[i].first.EqualsIgnoreCase(name)) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+const MessageView& HttpRequest::GetBody() const
+{
+    return body_;
+}
+
+bool HttpRequest::IsChunked() const
+{
+    return chunked_;
+}
+
+bool HttpRequest::IsKeepAlive() const
+{
+    return keep_alive_;
+}
+
+HttpParser::HttpParser(size_t max_header_len, size_t max_body_len) : max_header_len_(max_header_len), max_body_len_(max_body_len)
+{
+    Reset();
+}
+
+void HttpParser::Reset()
+{
+    state_ = State::RequestLine;
+    parsed_len_ = 0;
+    minor_version_ = 1;
+    headers_.clear();
+    body_.clear();
+    body_len_ = 0;
+    remain_len_ = 0;
+    chunked_ = false;
+    keep_alive_ = true;
+}
+
+size_t HttpParser::GetParsedLen() const
+{
+    return parsed_len_;
+}
+
+const HttpRequest& HttpParser::GetRequest() const
+{
+    return request_;
+}
+
+HttpParser* HttpParser::SetMaxHeaderLen(size_t max_header_len)
+{
+    max_header_len_ = max_header_len;
+
+    return this;
+}
+
+HttpParser* HttpParser::SetMaxBodyLen(size_t max_body_len)
+{
+    max_body_len_ = max_body_len;
+
+    return this;
+}
+
+size_t HttpParser::FindLineEnd(const char* data, size_t begin, size_t len)
+{
+    return begin + SimdSearch::Find(data + begin, len - begin, "\r\n", 2);
+}
+
+HttpParser::ParseStatus HttpParser::Parse(const char* data, size_t len)
+{
+    if (state_ == State::Complete) {
+        // 上一个请求已经交给调用者, 本次数据从下一个请求开始
+        Reset();
+    }
+    while (true) {
+        switch (state_) {
+            case State::RequestLine:
+            case State::Headers:
+            case State::Trailers:
+                {
+                    size_t line_end = FindLineEnd(data, parsed_len_, len);
+                    if (line_end == len) {
+                        size_t limit = state_ == State::Trailers ? parsed_len_ + max_header_len_ : max_header_len_;
+                        return len > limit ? ParseStatus::Error : ParseStatus::InComplete;
+                    }
+                    if (state_ != State::Trailers && line_end + 2 > max_header_len_) {
+                        return ParseStatus::Error;
+                    }
+                    ParseStatus status;
+                    if (state_ == State::RequestLine) {
+                        if (line_end == parsed_len_) {
+                            // 忽略请求之前多余的空行
+                            parsed_len_ += 2;
+                            continue;
+                        }
+                        status = ParseRequestLine(data, line_end);
+                    } else if (line_end == parsed_len_) {
+                        // 空行表示消息头(或chunked结尾的trailer)结束
+                        parsed_len_ += 2;
+                        status = state_ == State::Headers ? ProcessHeaders(data) : ParseStatus::Complete;
+                        if (status == ParseStatus::Complete && state_ == State::Trailers) {
+                            state_ = State::Complete;
+                        }
+                        if (state_ == State::Complete) {
+                            BuildRequest(data);
+                            return ParseStatus::Complete;
+                        }
+                        if (status == ParseStatus::Error) {
+                            return status;
+                        }
+                        continue;
+                    } else if (state_ == State::Headers) {
+                        status = ParseHeaderLine(data, line_end);
+                    } else {
+                        // trailer字段不对外提供
+                        status = ParseStatus::Complete;
+                    }
+                    if (status == ParseStatus::Error) {
+                        return status;
+                    }
+                    parsed_len_ = line_end + 2;
+                    break;
+                }
+            case State::Body:
+                {
+                    // Content-Length消息体只比较长度, 不逐字节扫描
+                    if (len - parsed_len_ < remain_len_) {
+                        return ParseStatus::InComplete;
+                    }
+                    Range range = {parsed_len_, remain_len_};
+                    body_.push_back(range);
+                    parsed_len_ += remain_len_;
+                    state_ = State::Complete;
+                    BuildRequest(data);
+                    return ParseStatus::Complete;
+                }
+            case State::ChunkSize:
+                {
+                    size_t line_end = FindLineEnd(data, parsed_len_, len);
+                    if (line_end == len) {
+                        return len - parsed_len_ > max_chunk_line_len_ ? ParseStatus::Error : ParseStatus::InComplete;
+                    }
+                    if (ParseChunkSize(data, line_end) == ParseStatus::Error) {
+                        return ParseStatus::Error;
+                    }
+                    parsed_len_ = line_end + 2;
+                    break;
+                }
+            case State::ChunkData:
+                {
+                    if (len - parsed_len_ < remain_len_ + 2) {
+                        return ParseStatus::InComplete;
+                    }
+                    if (data[parsed_len_ + remain_len_] != '\r' || data[parsed_len_ + remain_len_ + 1] != '\n') {
+                        return ParseStatus::Error;
+                    }
+                    Range range = {parsed_len_, remain_len_};
+                    body_.push_back(range);
+                    parsed_len_ += remain_len_ + 2;
+                    state_ = State::ChunkSize;
+                    break;
+                }
+            case State::Complete:
+                {
+                    return ParseStatus::Complete;
+                }
+        }
+    }
+}
+
+HttpParser::ParseStatus HttpParser::ParseRequestLine(const char* data, size_t line_end)
+{
+    // METHOD SP request-target SP HTTP/1.x
+    StringView line(data + parsed_len_, line_end - parsed_len_);
+    size_t method_end = line.Find(' ');
+    if (method_end == StringView::npos || method_end == 0) {
+        return ParseStatus::Error;
+    }
+    size_t target_end = line.Find(' ', method_end + 1);
+    if (target_end == StringView::npos || target_end == method_end + 1) {
+        return ParseStatus::Error;
+    }
+    StringView version = line.Substr(target_end + 1);
+    if (version.GetLen() != 8 || memcmp(version.GetData(), "HTTP/1.", 7) != 0 || (version[7] != '0' && version[7] != '1')) {
+        return ParseStatus::Error;
+    }
+    method_.begin_ = parsed_len_;
+    method_.len_ = method_end;
+    target_.begin_ = parsed_len_ + method_end + 1;
+    target_.len_ = target_end - method_end - 1;
+    minor_version_ = version[7] - '0';
+    state_ = State::Headers;
+
+    return ParseStatus::Complete;
+}
+
+HttpParser::ParseStatus HttpParser::ParseHeaderLine(const char* data, size_t line_end)
+{
+    StringView line(data + parsed_len_, line_end - parsed_len_);
+    if (line[0] == ' ' || line[0] == '\t') {
+        // 不支持已废弃的多行消息头(obs-fold)
+        return ParseStatus::Error;
+    }
+    size_t colon_idx = line.Find(':');
+    if (colon_idx == StringView::npos || colon_idx == 0) {
+        return ParseStatus::Error;
+    }
+    // 消息头名称不能包含空白及控制字符
+    for (size_t i = 0; i < colon_idx; i++) {
+        unsigned char c = static_cast<unsigned char>(line[i]);
+        if (c <= ' ' || c == 0x7f) {
+            return ParseStatus::Error;
+        }
+    }
+    StringView value = line.Substr(colon_idx + 1).Trim();
+    Range name_range = {parsed_len_, colon_idx};
+    Range value_range = {static_cast<size_t>(value.GetData() - data), value.GetLen()};
+    headers_.push_back(std::make_pair(name_range, value_range));
+
+    return ParseStatus::Complete;
+}
+
+HttpParser::ParseStatus HttpParser::ProcessHeaders(const char* data)
+{
+    bool has_content_len = false;
+    size_t content_len = 0;
+    bool has_transfer_encoding = false;
+    bool close = false;
+    bool keep_alive = false;
+    for (size_t i = 0; i < headers_.size(); i++) {
+        StringView name(data + headers_[i].first.begin_, headers_[i].first.len_);
+        StringView value(data + headers_[i].second.begin_, headers_[i].second.len_);
+        if (name.EqualsIgnoreCase("Content-Length")) {
+            if (value.IsEmpty()) {
+                return ParseStatus::Error;
+            }
+            size_t len = 0;
+            for (size_t j = 0; j < value.GetLen(); j++) {
+                if (value[j] < '0' || value[j] > '9' || len > (static_cast<size_t>(-1) - 9) / 10) {
+                    return ParseStatus::Error;
+                }
+                len = len * 10 + (value[j] - '0');
+            }
+            // 多个不一致的Content-Length无法确定请求边界
+            if (has_content_len && len != content_len) {
+                return ParseStatus::Error;
+            }
+            has_content_len = true;
+            content_len = len;
+        } else if (name.EqualsIgnoreCase("Transfer-Encoding")) {
+            // 只有最后一个编码为chunked时才能确定请求边界
+            has_transfer_encoding = true;
+            size_t comma_idx = StringView::npos;
+            for (size_t j = value.GetLen(); j > 0; j--) {
+                if (value[j - 1] == ',') {
+                    comma_idx = j - 1;
+                    break;
+                }
+            }
+            StringView last_coding = comma_idx == StringView::npos ? value : value.Substr(comma_idx + 1).Trim();
+            chunked_ = last_coding.EqualsIgnoreCase("chunked");
+        } else if (name.EqualsIgnoreCase("Connection")) {
+            size_t begin = 0;
+            while (begin <= value.GetLen()) {
+                size_t comma_idx = value.Find(',', begin);
+                if (comma_idx == StringView::npos) {
+                    comma_idx = value.GetLen();
+                }
+                StringView option = value.Substr(begin, comma_idx - begin).Trim();
+                if (option.EqualsIgnoreCase("close")) {
+                    close = true;
+                } else if (option.EqualsIgnoreCase("keep-alive")) {
+                    keep_alive = true;
+                }
+                begin = comma_idx + 1;
+            }
+        }
+    }
+    // 同时带有Content-Length与Transfer-Encoding的请求可能被用于请求走私, 直接拒绝
+    if (has_transfer_encoding && (!chunked_ || has_content_len)) {
+        return ParseStatus::Error;
+    }
+    keep_alive_ = minor_version_ >= 1 ? !close : keep_alive && !close;
+    if (chunked_) {
+        state_ = State::ChunkSize;
+    } else if (content_len) {
+        if (max_body_len_ && content_len > max_body_len_) {
+            return ParseStatus::Error;
+        }
+        remain_len_ = content_len;
+        state_ = State::Body;
+    } else {
+        state_ = State::Complete;
+    }
+
+    return ParseStatus::Complete;
+}
+
+HttpParser::ParseStatus HttpParser::ParseChunkSize(const char* data, size_t line_end)
+{
+    // chunk-size [; chunk-ext] CRLF
+    size_t chunk_len = 0;
+    size_t idx = parsed_len_;
+    for (; idx < line_end; idx++) {
+        char c = data[idx];
+        int digit;
+        if (c >= '0' && c <= '9') {
+            digit = c - '0';
+        } else if (c >= 'a' && c <= 'f') {
+            digit = c - 'a' + 10;
+        } else if (c >= 'A' && c <= 'F') {
+            digit = c - 'A' + 10;
+        } else {
+            break;
+        }
+        if (chunk_len > (static_cast<size_t>(-1) >> 4)) {
+            return ParseStatus::Error;
+        }
+        chunk_len = (chunk_len << 4) | digit;
+    }
+    if (idx == parsed_len_ || (idx < line_end && data[idx] != ';' && data[idx] != ' ' && data[idx] != '\t')) {
+        return ParseStatus::Error;
+    }
+    if (max_body_len_ && chunk_len > max_body_len_ - body_len_) {
+        return ParseStatus::Error;
+    }
+    body_len_ += chunk_len;
+    remain_len_ = chunk_len;
+    state_ = chunk_len ? State::ChunkData : State::Trailers;
+
+    return ParseStatus::Complete;
+}
+
+void HttpParser::BuildRequest(const char* data)
+{
+    request_.method_ = StringView(data + method_.begin_, method_.len_);
+    request_.target_ = StringView(data + target_.begin_, target_.len_);
+    request_.minor_version_ = minor_version_;
+    request_.headers_.clear();
+    for (size_t i = 0; i < headers_.size(); i++) {
+        request_.headers_.push_back(std::make_pair(StringView(data + headers_[i].first.begin_, headers_[i].first.len_),
+                                                   StringView(data + headers_[i].second.begin_, headers_[i].second.len_)));
+    }
+    request_.body_ = MessageView();
+    for (size_t i = 0; i < body_.size(); i++) {
+        request_.body_.AppendSegment(data + body_[i].begin_, body_[i].len_);
+    }
+    request_.chunked_ = chunked_;
+    request_.keep_alive_ = keep_alive_;
+}
+
+} // namespace Imagine_Muduo
@@ -0,0 +1,332 @@
+#include "Imagine_Muduo/IoUringPoller.h"
+
+#include "Imagine_Muduo/log_macro.h"
+#include "Imagine_Muduo/EventLoop.h"
+#include "Imagine_Muduo/Channel.h"
+
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/epoll.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <algorithm>
+
+namespace Imagine_Muduo
+{
+
+// POLL_REMOVE自身的完成事件使用该user_data, 直接忽略
+static const uint64_t remove_user_data = UINT64_MAX;
+
+// NODROP保证CQ溢出时不丢完成事件, EXT_ARG(5.11)用于带超时的等待, RSRC_TAGS与multishot poll同在5.13引入
+static const unsigned required_features = IORING_FEAT_NODROP | IORING_FEAT_EXT_ARG | IORING_FEAT_RSRC_TAGS;
+
+static uint64_t MakeUserData(int fd, uint32_t generation)
+{
+    return (static_cast<uint64_t>(generation) << 32) | static_cast<uint32_t>(fd);
+}
+
+IoUringPoller::IoUringPoller(const EventLoop *loop, unsigned entries) : Poller(), loop_(loop), pending_submit_(0), next_generation_(0)
+{
+    io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    ring_fd_ = syscall(__NR_io_uring_setup, entries, &params);
+    if (ring_fd_ < 0) {
+        IMAGINE_MUDUO_LOG("io_uring setup exception!");
+        throw std::exception();
+    }
+    if ((params.features & required_features) != required_features) {
+        IMAGINE_MUDUO_LOG("io_uring without NODROP/EXT_ARG/multishot poll is not supported!");
+        close(ring_fd_);
+        throw std::exception();
+    }
+
+    sq_ring_size_ = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    cq_ring_size_ = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    if (params.features & IORING_FEAT_SINGLE_MMAP) {
+        sq_ring_size_ = cq_ring_size_ = std::max(sq_ring_size_, cq_ring_size_);
+    }
+    sq_ring_ptr_ = mmap(nullptr, sq_ring_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd_, IORING_OFF_SQ_RING);
+    if (sq_ring_ptr_ == MAP_FAILED) {
+        close(ring_fd_);
+        throw std::exception();
+    }
+    if (params.features & IORING_FEAT_SINGLE_MMAP) {
+        cq_ring_ptr_ = sq_ring_ptr_;
+    } else {
+        cq_ring_ptr_ = mmap(nullptr, cq_ring_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd_, IORING_OFF_CQ_RING);
+        if (cq_ring_ptr_ == MAP_FAILED) {
+            munmap(sq_ring_ptr_, sq_ring_size_);
+            close(ring_fd_);
+            throw std::exception();
+        }
+    }
+    sqes_size_ = params.sq_entries * sizeof(io_uring_sqe);
+    sqes_ = static_cast<io_uring_sqe*>(mmap(nullptr, sqes_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd_, IORING_OFF_SQES));
+    if (sqes_ == MAP_FAILED) {
+        if (cq_ring_ptr_ != sq_ring_ptr_) {
+            munmap(cq_ring_ptr_, cq_ring_size_);
+        }
+        munmap(sq_ring_ptr_, sq_ring_size_);
+        close(ring_fd_);
+        throw std::exception();
+    }
+
+    char* sq_ptr = static_cast<char*>(sq_ring_ptr_);
+    sq_head_ = reinterpret_cast<unsigned*>(sq_ptr + params.sq_off.head);
+    sq_tail_ = reinterpret_cast<unsigned*>(sq_ptr + params.sq_off.tail);
+    sq_mask_ = *reinterpret_cast<unsigned*>(sq_ptr + params.sq_off.ring_mask);
+    sq_entries_ = *reinterpret_cast<unsigned*>(sq_ptr + params.sq_off.ring_entries);
+    unsigned* sq_array = reinterpret_cast<unsigned*>(sq_ptr + params.sq_off.array);
+    for (unsigned i = 0; i < sq_entries_; i++) {
+        sq_array[i] = i;
+    }
+
+    char* cq_ptr = static_cast<char*>(cq_ring_ptr_);
+    cq_head_ = reinterpret_cast<unsigned*>(cq_ptr + params.cq_off.head);
+    cq_tail_ = reinterpret_cast<unsigned*>(cq_ptr + params.cq_off.tail);
+    cq_mask_ = *reinterpret_cast<unsigned*>(cq_ptr + params.cq_off.ring_mask);
+    cqes_ = reinterpret_cast<io_uring_cqe*>(cq_ptr + params.cq_off.cqes);
+
+    if (pthread_mutex_init(&ring_lock_, nullptr) != 0) {
+        throw std::exception();
+    }
+}
+
+IoUringPoller::~IoUringPoller()
+{
+    munmap(sqes_, sqes_size_);
+    if (cq_ring_ptr_ != sq_ring_ptr_) {
+        munmap(cq_ring_ptr_, cq_ring_size_);
+    }
+    munmap(sq_ring_ptr_, sq_ring_size_);
+    close(ring_fd_);
+    pthread_mutex_destroy(&ring_lock_);
+}
+
+bool IoUringPoller::IsSupported()
+{
+    io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    int fd = syscall(__NR_io_uring_setup, 2, &params);
+    if (fd < 0) {
+        return false;
+    }
+    close(fd);
+
+    return (params.features & required_features) == required_features;
+}
+
+Poller* IoUringPoller::poll(int timeoutMs, std::vector<std::shared_ptr<Channel>>& active_channels)
+{
+    pthread_mutex_lock(&ring_lock_);
+    unsigned to_submit = pending_submit_;
+    pending_submit_ = 0;
+    pthread_mutex_unlock(&ring_lock_);
+
+    // 提交本轮loop线程上积累的SQE并等待至少一个完成事件, 只需要一次io_uring_enter
+    if (__atomic_load_n(cq_head_, __ATOMIC_RELAXED) == __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE)) {
+        if (timeoutMs < 0) {
+            Enter(to_submit, 1, IORING_ENTER_GETEVENTS);
+        } else {
+            __kernel_timespec ts;
+            ts.tv_sec = timeoutMs / 1000;
+            ts.tv_nsec = (timeoutMs % 1000) * 1000000LL;
+            io_uring_getevents_arg arg;
+            memset(&arg, 0, sizeof(arg));
+            arg.ts = reinterpret_cast<uint64_t>(&ts);
+            int ret = syscall(__NR_io_uring_enter, ring_fd_, to_submit, 1, IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG, &arg, sizeof(arg));
+            if (ret < 0 && errno != ETIME && errno != EINTR) {
+                IMAGINE_MUDUO_LOG("io_uring enter exception!");
+                throw std::exception();
+            }
+        }
+    } else if (to_submit) {
+        Enter(to_submit, 0, 0);
+    }
+
+    unsigned head = __atomic_load_n(cq_head_, __ATOMIC_RELAXED);
+    unsigned tail = __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE);
+    pthread_mutex_lock(&ring_lock_);
+    for (; head != tail; head++) {
+        const io_uring_cqe* cqe = &cqes_[head & cq_mask_];
+        if (cqe->user_data == remove_user_data) {
+            continue;
+        }
+        int fd = static_cast<int>(cqe->user_data & 0xffffffff);
+        uint32_t generation = static_cast<uint32_t>(cqe->user_data >> 32);
+        std::unordered_map<int, PollEntry>::iterator it = channels_.find(fd);
+        if (it == channels_.end() || it->second.generation_ != generation) {
+            // 已被删除或已被重新注册的poll请求产生的过期事件
+            continue;
+        }
+        PollEntry& entry = it->second;
+        if (!(cqe->flags & IORING_CQE_F_MORE)) {
+            entry.armed_ = false;
+        }
+        if (cqe->res < 0) {
+            if (cqe->res != -ECANCELED) {
+                IMAGINE_MUDUO_LOG("io_uring poll exception, fd is %d, res is %d", fd, cqe->res);
+            }
+            continue;
+        }
+        entry.channel_->SetRevents(cqe->res);
+        active_channels.push_back(entry.channel_);
+        if (entry.multishot_ && !entry.armed_) {
+            // multishot poll被内核终止(如CQ溢出), 需要重新注册
+            Submit(PrepPollAdd(fd, entry));
+        }
+    }
+    __atomic_store_n(cq_head_, head, __ATOMIC_RELEASE);
+    pthread_mutex_unlock(&ring_lock_);
+
+    return this;
+}
+
+Poller* IoUringPoller::AddChannel(const std::shared_ptr<Channel>& channel)
+{
+    int fd = channel->Getfd();
+    pthread_mutex_lock(&ring_lock_);
+    PollEntry& entry = channels_[fd];
+    entry.channel_ = channel;
+    entry.armed_ = false;
+    entry.events_ = channel->GetEvents();
+    Submit(PrepPollAdd(fd, entry));
+    pthread_mutex_unlock(&ring_lock_);
+
+    return this;
+}
+
+const Poller* IoUringPoller::Update(int fd, int events) const
+{
+    pthread_mutex_lock(&ring_lock_);
+    std::unordered_map<int, PollEntry>::iterator it = channels_.find(fd);
+    if (it == channels_.end()) {
+        // 尚未加入Poller的Channel(与epoll_ctl返回ENOENT一致)
+        pthread_mutex_unlock(&ring_lock_);
+        return this;
+    }
+    PollEntry& entry = it->second;
+    int sqe_num = 0;
+    if (entry.armed_) {
+        sqe_num += PrepPollRemove(fd, entry);
+    }
+    entry.events_ = events;
+    sqe_num += PrepPollAdd(fd, entry);
+    Submit(sqe_num);
+    pthread_mutex_unlock(&ring_lock_);
+
+    return this;
+}
+
+Poller* IoUringPoller::DelChannel(const std::shared_ptr<Channel>& channel)
+{
+    int fd = channel->Getfd();
+    pthread_mutex_lock(&ring_lock_);
+    std::unordered_map<int, PollEntry>::iterator it = channels_.find(fd);
+    if (it != channels_.end()) {
+        if (it->second.armed_) {
+            // close之前必须确保poll请求已经取消, 立即提交
+            // SQE按顺序消费, 需要连同此前积累(包括其它线程尚未提交)的SQE一起提交, 多出的数目内核会忽略
+            PrepPollRemove(fd, it->second);
+            Enter(*sq_tail_ - __atomic_load_n(sq_head_, __ATOMIC_ACQUIRE), 0, 0);
+            pending_submit_ = 0;
+        }
+        channels_.erase(it);
+    }
+    pthread_mutex_unlock(&ring_lock_);
+    close(fd);
+
+    return this;
+}
+
+std::shared_ptr<Channel> IoUringPoller::FindChannel(int fd) const
+{
+    pthread_mutex_lock(&ring_lock_);
+    std::unordered_map<int, PollEntry>::const_iterator it = channels_.find(fd);
+    std::shared_ptr<Channel> temp_channel;
+    if (it == channels_.end()) {
+        // 重复删除
+        IMAGINE_MUDUO_LOG("delete already!");
+    } else {
+        temp_channel = it->second.channel_;
+    }
+    pthread_mutex_unlock(&ring_lock_);
+
+    return temp_channel;
+}
+
+int IoUringPoller::PrepPollAdd(int fd, PollEntry& entry) const
+{
+    io_uring_sqe* sqe = GetSqe();
+    // 代数在整个Poller内单调递增, fd被复用时旧poll请求的完成事件也不会与新请求混淆
+    entry.generation_ = ++next_generation_;
+    entry.armed_ = true;
+    entry.multishot_ = !(entry.events_ & EPOLLONESHOT);
+    sqe->opcode = IORING_OP_POLL_ADD;
+    sqe->fd = fd;
+    sqe->poll32_events = entry.events_ & ~(EPOLLONESHOT | EPOLLET);
+    sqe->len = entry.multishot_ ? IORING_POLL_ADD_MULTI : 0;
+    sqe->user_data = MakeUserData(fd, entry.generation_);
+    CommitSqe();
+
+    return 1;
+}
+
+int IoUringPoller::PrepPollRemove(int fd, const PollEntry& entry) const
+{
+    io_uring_sqe* sqe = GetSqe();
+    sqe->opcode = IORING_OP_POLL_REMOVE;
+    sqe->fd = -1;
+    sqe->addr = MakeUserData(fd, entry.generation_);
+    sqe->user_data = remove_user_data;
+    CommitSqe();
+
+    return 1;
+}
+
+io_uring_sqe* IoUringPoller::GetSqe() const
+{
+    unsigned tail = *sq_tail_;
+    if (tail - __atomic_load_n(sq_head_, __ATOMIC_ACQUIRE) >= sq_entries_) {
+        // SQ已满, 先把积累的SQE提交给内核
+        Enter(pending_submit_, 0, 0);
+        pending_submit_ = 0;
+    }
+    io_uring_sqe* sqe = &sqes_[tail & sq_mask_];
+    memset(sqe, 0, sizeof(*sqe));
+
+    return sqe;
+}
+
+void IoUringPoller::CommitSqe() const
+{
+    // SQE填写完毕后才对内核可见, 避免其它线程的io_uring_enter提交未填写完的SQE
+    __atomic_store_n(sq_tail_, *sq_tail_ + 1, __ATOMIC_RELEASE);
+}
+
+void IoUringPoller::Submit(int sqe_num) const
+{
+    if (sqe_num == 0) {
+        return;
+    }
+    if (loop_->IsInLoopThread()) {
+        pending_submit_ += sqe_num;
+    } else {
+        Enter(sqe_num, 0, 0);
+    }
+}
+
+void IoUringPoller::Enter(unsigned to_submit, unsigned min_complete, unsigned flags) const
+{
+    if (to_submit == 0 && min_complete == 0) {
+        return;
+    }
+    int ret = syscall(__NR_io_uring_enter, ring_fd_, to_submit, min_complete, flags, nullptr, 0);
+    if (ret < 0 && errno != EINTR) {
+        IMAGINE_MUDUO_LOG("io_uring enter exception!");
+        throw std::exception();
+    }
+}
+
+} // namespace Imagine_Muduo
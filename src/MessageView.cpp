@@ -0,0 +1,123 @@
+#include "Imagine_Muduo/MessageView.h"
+
+namespace Imagine_Muduo
+{
+
+MessageView::SegmentIterator::SegmentIterator(const MessageView* view, size_t idx) : view_(view), idx_(idx)
+{
+}
+
+const MessageView::Segment& MessageView::SegmentIterator::operator*() const
+{
+    return view_->GetSegment(idx_);
+}
+
+const MessageView::Segment* MessageView::SegmentIterator::operator->() const
+{
+    return &view_->GetSegment(idx_);
+}
+
+MessageView::SegmentIterator& MessageView::SegmentIterator::operator++()
+{
+    idx_++;
+
+    return *this;
+}
+
+bool MessageView::SegmentIterator::operator==(const SegmentIterator& other) const
+{
+    return view_ == other.view_ && idx_ == other.idx_;
+}
+
+bool MessageView::SegmentIterator::operator!=(const SegmentIterator& other) const
+{
+    return !(*this == other);
+}
+
+MessageView::MessageView() : len_(0)
+{
+    first_.data_ = nullptr;
+    first_.len_ = 0;
+}
+
+MessageView::MessageView(const char* data, size_t len, std::shared_ptr<const char> pin) : len_(len)
+{
+    first_.data_ = data;
+    first_.len_ = len;
+    if (pin) {
+        pins_.push_back(pin);
+    }
+}
+
+MessageView* MessageView::AppendSegment(const char* data, size_t len, std::shared_ptr<const char> pin)
+{
+    if (len == 0) {
+        return this;
+    }
+    if (first_.len_ == 0) {
+        first_.data_ = data;
+        first_.len_ = len;
+    } else {
+        Segment segment = {data, len};
+        segments_.push_back(segment);
+    }
+    len_ += len;
+    if (pin) {
+        pins_.push_back(pin);
+    }
+
+    return this;
+}
+
+const char* MessageView::GetData() const
+{
+    return first_.data_;
+}
+
+size_t MessageView::GetLen() const
+{
+    return len_;
+}
+
+size_t MessageView::GetSegmentNum() const
+{
+    return first_.len_ == 0 ? 0 : segments_.size() + 1;
+}
+
+bool MessageView::IsContiguous() const
+{
+    return segments_.empty();
+}
+
+bool MessageView::IsPinned() const
+{
+    return !pins_.empty();
+}
+
+MessageView::SegmentIterator MessageView::begin() const
+{
+    return SegmentIterator(this, 0);
+}
+
+MessageView::SegmentIterator MessageView::end() const
+{
+    return SegmentIterator(this, GetSegmentNum());
+}
+
+std::string MessageView::ToString() const
+{
+    std::string message;
+    message.reserve(len_);
+    for (SegmentIterator it = begin(); it != end(); ++it) {
+        message.append(it->data_, it->len_);
+    }
+
+    return message;
+}
+
+const MessageView::Segment& MessageView::GetSegment(size_t idx) const
+{
+    return idx == 0 ? first_ : segments_[idx - 1];
+}
+
+} // namespace Imagine_Muduo
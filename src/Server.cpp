@@ -24,6 +24,9 @@ Server::~Server()
 {
     delete loop_;
     delete acceptor_;
+    for (size_t i = 0; i < shard_acceptors_.size(); i++) {
+        delete shard_acceptors_[i];
+    }
     delete msg_conn_;
     delete destroy_thread_;
 }
@@ -35,11 +38,19 @@ void Server::Init()
         msg_conn_->SetServer(this);
         read_callback_ = std::bind(&Connection::DefaultReadCallback, msg_conn_, std::placeholders::_1);
         write_callback_ = std::bind(&Connection::DefaultWriteCallback, msg_conn_, std::placeholders::_1);
+        overload_callback_ = std::bind(&Connection::DefaultOverloadCallback, msg_conn_, std::placeholders::_1);
+        write_complete_callback_ = std::bind(&Connection::DefaultWriteCompleteCallback, msg_conn_, std::placeholders::_1);
+        high_water_mark_callback_ = std::bind(&Connection::DefaultHighWaterMarkCallback, msg_conn_, std::placeholders::_1);
+        low_water_mark_callback_ = std::bind(&Connection::DefaultLowWaterMarkCallback, msg_conn_, std::placeholders::_1);
     }
 
     if (loop_ != nullptr) {
         Connection*  old_acceptor = acceptor_;
-        acceptor_ = acceptor_->Create(loop_->GetListenChannel());
+        std::vector<std::shared_ptr<Channel>> listen_channels = loop_->GetListenChannels();
+        acceptor_ = acceptor_->Create(listen_channels[0]);
+        for (size_t i = 1; i < listen_channels.size(); i++) {
+            shard_acceptors_.push_back(old_acceptor->Create(listen_channels[i]));
+        }
         delete old_acceptor;
     }
 
@@ -93,6 +104,9 @@ Server* const Server::AddAndSetConnection(Connection* new_conn)
 {
     SetReadCallback(new_conn);
     SetWriteCallback(new_conn);
+    SetOverloadCallback(new_conn);
+    SetWriteCompleteCallback(new_conn);
+    SetWaterMarkCallback(new_conn);
     AddConnection(new_conn);
 
     return this;
@@ -120,6 +134,28 @@ Server* const Server::SetWriteCallback(Connection* new_conn)
     new_conn->SetWriteCallback(write_callback_);
 }
 
+Server* const Server::SetOverloadCallback(Connection* new_conn)
+{
+    new_conn->SetOverloadCallback(overload_callback_);
+
+    return this;
+}
+
+Server* const Server::SetWriteCompleteCallback(Connection* new_conn)
+{
+    new_conn->SetWriteCompleteCallback(write_complete_callback_);
+
+    return this;
+}
+
+Server* const Server::SetWaterMarkCallback(Connection* new_conn)
+{
+    new_conn->SetHighWaterMarkCallback(high_water_mark_callback_);
+    new_conn->SetLowWaterMarkCallback(low_water_mark_callback_);
+
+    return this;
+}
+
 Connection* Server::GetMessageConnection() const
 {
     return msg_conn_;
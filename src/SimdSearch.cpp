@@ -0,0 +1,175 @@
+#include "Imagine_Muduo/SimdSearch.h"
+
+#include <cstring>
+#include <stdint.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+namespace Imagine_Muduo
+{
+
+size_t SimdSearch::Find(const char* data, size_t len, const char* target, size_t target_len)
+{
+    static const FindFunc find_func = SelectFind();
+    if (target_len == 0 || len < target_len) {
+        return len;
+    }
+
+    return find_func(data, len, target, target_len);
+}
+
+size_t SimdSearch::TrimRight(const char* data, size_t len, char c)
+{
+    static const TrimFunc trim_func = SelectTrim();
+
+    return trim_func(data, len, c);
+}
+
+SimdSearch::FindFunc SimdSearch::SelectFind()
+{
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        return &SimdSearch::FindAvx2;
+    }
+    if (__builtin_cpu_supports("sse2")) {
+        return &SimdSearch::FindSse2;
+    }
+#endif
+
+    return &SimdSearch::FindScalar;
+}
+
+SimdSearch::TrimFunc SimdSearch::SelectTrim()
+{
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        return &SimdSearch::TrimRightAvx2;
+    }
+    if (__builtin_cpu_supports("sse2")) {
+        return &SimdSearch::TrimRightSse2;
+    }
+#endif
+
+    return &SimdSearch::TrimRightScalar;
+}
+
+size_t SimdSearch::FindScalar(const char* data, size_t len, const char* target, size_t target_len)
+{
+    if (target_len == 0 || len < target_len) {
+        return len;
+    }
+    size_t last_pos = len - target_len;
+    size_t idx = 0;
+    while (idx <= last_pos) {
+        const char* ptr = static_cast<const char*>(memchr(data + idx, target[0], last_pos - idx + 1));
+        if (ptr == nullptr) {
+            break;
+        }
+        idx = ptr - data;
+        if (memcmp(ptr + 1, target + 1, target_len - 1) == 0) {
+            return idx;
+        }
+        idx++;
+    }
+
+    return len;
+}
+
+size_t SimdSearch::TrimRightScalar(const char* data, size_t len, char c)
+{
+    while (len > 0 && data[len - 1] == c) {
+        len--;
+    }
+
+    return len;
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+
+__attribute__((target("sse2")))
+size_t SimdSearch::FindSse2(const char* data, size_t len, const char* target, size_t target_len)
+{
+    const __m128i first = _mm_set1_epi8(target[0]);
+    const __m128i last = _mm_set1_epi8(target[target_len - 1]);
+    // 候选起始位置为[0, pos_num), 每次比较16个候选位置的首字节与尾字节
+    size_t pos_num = len - target_len + 1;
+    size_t idx = 0;
+    for (; idx + 16 <= pos_num; idx += 16) {
+        __m128i block_first = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + idx));
+        __m128i block_last = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + idx + target_len - 1));
+        uint32_t mask = _mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(block_first, first), _mm_cmpeq_epi8(block_last, last)));
+        while (mask) {
+            size_t pos = idx + __builtin_ctz(mask);
+            if (target_len <= 2 || memcmp(data + pos + 1, target + 1, target_len - 2) == 0) {
+                return pos;
+            }
+            mask &= mask - 1;
+        }
+    }
+
+    return idx + FindScalar(data + idx, len - idx, target, target_len);
+}
+
+__attribute__((target("avx2")))
+size_t SimdSearch::FindAvx2(const char* data, size_t len, const char* target, size_t target_len)
+{
+    const __m256i first = _mm256_set1_epi8(target[0]);
+    const __m256i last = _mm256_set1_epi8(target[target_len - 1]);
+    size_t pos_num = len - target_len + 1;
+    size_t idx = 0;
+    for (; idx + 32 <= pos_num; idx += 32) {
+        __m256i block_first = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + idx));
+        __m256i block_last = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + idx + target_len - 1));
+        uint32_t mask = _mm256_movemask_epi8(_mm256_and_si256(_mm256_cmpeq_epi8(block_first, first), _mm256_cmpeq_epi8(block_last, last)));
+        while (mask) {
+            size_t pos = idx + __builtin_ctz(mask);
+            if (target_len <= 2 || memcmp(data + pos + 1, target + 1, target_len - 2) == 0) {
+                return pos;
+            }
+            mask &= mask - 1;
+        }
+    }
+
+    return idx + FindScalar(data + idx, len - idx, target, target_len);
+}
+
+__attribute__((target("sse2")))
+size_t SimdSearch::TrimRightSse2(const char* data, size_t len, char c)
+{
+    const __m128i target = _mm_set1_epi8(c);
+    while (len >= 16) {
+        __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + len - 16));
+        uint32_t mask = ~_mm_movemask_epi8(_mm_cmpeq_epi8(block, target)) & 0xFFFF;
+        if (mask) {
+            // 最高的不等于c的字节
+            return len - 16 + (31 - __builtin_clz(mask)) + 1;
+        }
+        len -= 16;
+    }
+
+    return TrimRightScalar(data, len, c);
+}
+
+__attribute__((target("avx2")))
+size_t SimdSearch::TrimRightAvx2(const char* data, size_t len, char c)
+{
+    const __m256i target = _mm256_set1_epi8(c);
+    while (len >= 32) {
+        __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + len - 32));
+        uint32_t mask = ~static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(block, target)));
+        if (mask) {
+            return len - 32 + (31 - __builtin_clz(mask)) + 1;
+        }
+        len -= 32;
+    }
+
+    return TrimRightScalar(data, len, c);
+}
+
+#endif
+
+} // namespace Imagine_Muduo
@@ -0,0 +1,130 @@
+#include "Imagine_Muduo/StringView.h"
+
+#include <cstring>
+
+namespace Imagine_Muduo
+{
+
+const size_t StringView::npos;
+
+StringView::StringView() : data_(""), len_(0)
+{
+}
+
+StringView::StringView(const char* data, size_t len) : data_(data), len_(len)
+{
+}
+
+StringView::StringView(const char* str) : data_(str), len_(strlen(str))
+{
+}
+
+StringView::StringView(const std::string& str) : data_(str.data()), len_(str.size())
+{
+}
+
+const char* StringView::GetData() const
+{
+    return data_;
+}
+
+size_t StringView::GetLen() const
+{
+    return len_;
+}
+
+bool StringView::IsEmpty() const
+{
+    return len_ == 0;
+}
+
+char StringView::operator[](size_t idx) const
+{
+    return data_[idx];
+}
+
+const char* StringView::begin() const
+{
+    return data_;
+}
+
+const char* StringView::end() const
+{
+    return data_ + len_;
+}
+
+StringView StringView::Substr(size_t pos, size_t len) const
+{
+    if (pos > len_) {
+        pos = len_;
+    }
+    if (len > len_ - pos) {
+        len = len_ - pos;
+    }
+
+    return StringView(data_ + pos, len);
+}
+
+size_t StringView::Find(char c, size_t pos) const
+{
+    if (pos >= len_) {
+        return npos;
+    }
+    const char* found = static_cast<const char*>(memchr(data_ + pos, c, len_ - pos));
+
+    return found == nullptr ? npos : found - data_;
+}
+
+StringView StringView::Trim() const
+{
+    size_t begin = 0;
+    size_t end = len_;
+    while (begin < end && (data_[begin] == ' ' || data_[begin] == '\t')) {
+        begin++;
+    }
+    while (end > begin && (data_[end - 1] == ' ' || data_[end - 1] == '\t')) {
+        end--;
+    }
+
+    return StringView(data_ + begin, end - begin);
+}
+
+bool StringView::EqualsIgnoreCase(const StringView& other) const
+{
+    if (len_ != other.len_) {
+        return false;
+    }
+    for (size_t i = 0; i < len_; i++) {
+        // 只处理ASCII字母, 与locale无关
+        char a = data_[i];
+        char b = other.data_[i];
+        if (a >= 'A' && a <= 'Z') {
+            a += 'a' - 'A';
+        }
+        if (b >= 'A' && b <= 'Z') {
+            b += 'a' - 'A';
+        }
+        if (a != b) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool StringView::operator==(const StringView& other) const
+{
+    return len_ == other.len_ && memcmp(data_, other.data_, len_) == 0;
+}
+
+bool StringView::operator!=(const StringView& other) const
+{
+    return !(*this == other);
+}
+
+std::string StringView::ToString() const
+{
+    return std::string(data_, len_);
+}
+
+} // namespace Imagine_Muduo
@@ -4,6 +4,7 @@
 #include "Imagine_Muduo/Server.h"
 #include "Imagine_Muduo/Buffer.h"
 #include "Imagine_Muduo/Channel.h"
+#include "Imagine_Muduo/EventLoop.h"
 
 namespace Imagine_Muduo
 {
@@ -36,7 +37,7 @@ Connection* TcpConnection::Create(const std::shared_ptr<Channel>& channel) const
 void TcpConnection::ReadHandler()
 {
     IMAGINE_MUDUO_LOG("Hello! This is TcpConnection!");
-    if (!read_buffer_->Read(channel_->Getfd())) {
+    if (!read_buffer_->Read(channel_->Getfd(), loop_->IsEdgeTriggered())) {
         IMAGINE_MUDUO_LOG("close channel:%d", channel_->Getfd());
         server_->CloseConnection(GetPeerIp(), GetPeerPort());
         // Close();
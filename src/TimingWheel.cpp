@@ -0,0 +1,237 @@
+#include "Imagine_Muduo/TimingWheel.h"
+
+#include <time.h>
+#include <algorithm>
+
+namespace Imagine_Muduo
+{
+
+const int TimingWheel::slot_nums_[TimingWheel::level_num_] = {1000, 60, 60, 24};
+const long long TimingWheel::level_ticks_[TimingWheel::level_num_] = {1, 1000, 60 * 1000, 60 * 60 * 1000};
+
+TimingWheel::TimingWheel() : current_(GetNowMs()), running_node_(nullptr), free_list_(nullptr)
+{
+    for (int level = 0; level < level_num_; level++) {
+        slots_[level].assign(slot_nums_[level], nullptr);
+        timer_nums_[level] = 0;
+    }
+}
+
+TimingWheel::~TimingWheel()
+{
+    for (size_t i = 0; i < chunks_.size(); i++) {
+        delete[] chunks_[i];
+    }
+}
+
+long long TimingWheel::GetNowMs()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return static_cast<long long>(now.tv_sec) * 1000 + now.tv_nsec / 1000000;
+}
+
+void TimingWheel::AddTimer(long long timer_id, TimerCallback timer_callback, long long delay_ms, long long interval_ms)
+{
+    long long now = GetNowMs();
+    if (timers_.empty() && current_ < now) {
+        // 时间轮为空时直接跳到当前时间, 避免逐tick推进空闲期间
+        current_ = now;
+    }
+    TimerNode* node = AllocNode();
+    node->timer_id_ = timer_id;
+    node->timer_callback_ = timer_callback;
+    node->interval_ = interval_ms;
+    // 当前tick的槽位已经处理过, 最早只能在下一个tick执行
+    node->expire_ = std::max(now + delay_ms, current_ + 1);
+    node->cancelled_ = false;
+    Insert(node);
+    timers_[timer_id] = node;
+}
+
+bool TimingWheel::CancelTimer(long long timer_id)
+{
+    std::unordered_map<long long, TimerNode*>::iterator it = timers_.find(timer_id);
+    if (it == timers_.end()) {
+        return false;
+    }
+    TimerNode* node = it->second;
+    timers_.erase(it);
+    if (node == running_node_) {
+        // 定时器在自己的回调中被删除, 回调结束后再回收
+        node->cancelled_ = true;
+    } else {
+        Unlink(node);
+        FreeNode(node);
+    }
+
+    return true;
+}
+
+void TimingWheel::Advance(long long now_ms)
+{
+    while (current_ < now_ms) {
+        if (timers_.empty()) {
+            current_ = now_ms;
+            break;
+        }
+        if (timer_nums_[0] == 0) {
+            // 最低层为空时只有秒边界上的下沉可能产生到期定时器, 直接跳过中间的tick
+            long long next_boundary = (current_ / level_ticks_[1] + 1) * level_ticks_[1];
+            if (now_ms < next_boundary) {
+                current_ = now_ms;
+                break;
+            }
+            current_ = next_boundary - 1;
+        }
+        current_++;
+        for (int level = level_num_ - 1; level > 0; level--) {
+            if (current_ % level_ticks_[level] == 0) {
+                Cascade(level);
+            }
+        }
+        RunExpired();
+    }
+}
+
+long long TimingWheel::GetNextExpire() const
+{
+    if (timers_.empty()) {
+        return -1;
+    }
+    long long next_expire = -1;
+    if (timer_nums_[0]) {
+        for (long long i = 1; i < slot_nums_[0]; i++) {
+            if (slots_[0][(current_ + i) % slot_nums_[0]] != nullptr) {
+                next_expire = current_ + i;
+                break;
+            }
+        }
+    }
+    for (int level = 1; level < level_num_; level++) {
+        if (!timer_nums_[level]) {
+            continue;
+        }
+        long long base = current_ / level_ticks_[level];
+        for (long long i = 1; i <= slot_nums_[level]; i++) {
+            if (slots_[level][(base + i) % slot_nums_[level]] != nullptr) {
+                long long boundary = (base + i) * level_ticks_[level];
+                if (next_expire == -1 || boundary < next_expire) {
+                    next_expire = boundary;
+                }
+                break;
+            }
+        }
+    }
+
+    return next_expire;
+}
+
+long long TimingWheel::GetCurrentTime() const
+{
+    return current_;
+}
+
+size_t TimingWheel::GetTimerNum() const
+{
+    return timers_.size();
+}
+
+TimingWheel::TimerNode* TimingWheel::AllocNode()
+{
+    if (free_list_ == nullptr) {
+        TimerNode* chunk = new TimerNode[chunk_size_];
+        chunks_.push_back(chunk);
+        for (int i = 0; i < chunk_size_; i++) {
+            chunk[i].next_ = free_list_;
+            free_list_ = chunk + i;
+        }
+    }
+    TimerNode* node = free_list_;
+    free_list_ = node->next_;
+    node->prev_ = node->next_ = nullptr;
+
+    return node;
+}
+
+void TimingWheel::FreeNode(TimerNode* node)
+{
+    node->timer_callback_ = nullptr;
+    node->prev_ = nullptr;
+    node->next_ = free_list_;
+    free_list_ = node;
+}
+
+void TimingWheel::Insert(TimerNode* node)
+{
+    long long delta = node->expire_ - current_;
+    int level = 0;
+    while (level < level_num_ - 1 && delta >= level_ticks_[level + 1]) {
+        level++;
+    }
+    // 超出最高层范围的定时器放在一整圈之后的槽位, 下沉时会重新计算所在层
+    long long base = current_ / level_ticks_[level];
+    long long offset = std::min(node->expire_ / level_ticks_[level] - base, static_cast<long long>(slot_nums_[level]));
+    int slot = static_cast<int>((base + offset) % slot_nums_[level]);
+
+    node->level_ = level;
+    node->slot_ = slot;
+    node->prev_ = nullptr;
+    node->next_ = slots_[level][slot];
+    if (node->next_ != nullptr) {
+        node->next_->prev_ = node;
+    }
+    slots_[level][slot] = node;
+    timer_nums_[level]++;
+}
+
+void TimingWheel::Unlink(TimerNode* node)
+{
+    if (node->prev_ != nullptr) {
+        node->prev_->next_ = node->next_;
+    } else {
+        slots_[node->level_][node->slot_] = node->next_;
+    }
+    if (node->next_ != nullptr) {
+        node->next_->prev_ = node->prev_;
+    }
+    node->prev_ = node->next_ = nullptr;
+    timer_nums_[node->level_]--;
+}
+
+void TimingWheel::Cascade(int level)
+{
+    int slot = static_cast<int>((current_ / level_ticks_[level]) % slot_nums_[level]);
+    TimerNode* node = slots_[level][slot];
+    slots_[level][slot] = nullptr;
+    while (node != nullptr) {
+        TimerNode* next = node->next_;
+        timer_nums_[level]--;
+        Insert(node);
+        node = next;
+    }
+}
+
+void TimingWheel::RunExpired()
+{
+    TimerNode*& head = slots_[0][current_ % slot_nums_[0]];
+    while (head != nullptr) {
+        TimerNode* node = head;
+        Unlink(node);
+        running_node_ = node;
+        node->timer_callback_();
+        running_node_ = nullptr;
+        if (node->cancelled_) {
+            FreeNode(node);
+        } else if (node->interval_ > 0) {
+            node->expire_ = std::max(node->expire_ + node->interval_, current_ + 1);
+            Insert(node);
+        } else {
+            timers_.erase(node->timer_id_);
+            FreeNode(node);
+        }
+    }
+}
+
+} // namespace Imagine_Muduo
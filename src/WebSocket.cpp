@@ -0,0 +1,305 @@
+#include "Imagine_Muduo/WebSocket.h"
+
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+namespace Imagine_Muduo
+{
+
+const size_t WebSocketParser::max_header_len_;
+
+WebSocketMessage::WebSocketMessage() : opcode_(Opcode::Text), close_code_(0)
+{
+}
+
+WebSocketMessage::Opcode WebSocketMessage::GetOpcode() const
+{
+    return opcode_;
+}
+
+bool WebSocketMessage::IsText() const
+{
+    return opcode_ == Opcode::Text;
+}
+
+bool WebSocketMessage::IsBinary() const
+{
+    return opcode_ == Opcode::Binary;
+}
+
+const MessageView& WebSocketMessage::GetPayload() const
+{
+    return payload_;
+}
+
+uint16_t WebSocketMessage::GetCloseCode() const
+{
+    return close_code_;
+}
+
+WebSocketParser::WebSocketParser(size_t max_message_len)
+    : max_message_len_(max_message_len)
+{
+    Reset();
+}
+
+WebSocketParser::ParseStatus WebSocketParser::Parse(char* data, size_t len)
+{
+    if (message_done_) {
+        Reset();
+    }
+
+    while (true) {
+        size_t begin = next_frame_;
+        if (len < begin + 2) {
+            return ParseStatus::InComplete;
+        }
+        const unsigned char* header = reinterpret_cast<const unsigned char*>(data + begin);
+        // RSV1-3必须为0(未协商扩展), 客户端发送的帧必须带掩码
+        if ((header[0] & 0x70) || !(header[1] & 0x80)) {
+            return ParseStatus::Error;
+        }
+        bool fin = header[0] & 0x80;
+        unsigned char opcode = header[0] & 0x0f;
+        uint64_t payload_len = header[1] & 0x7f;
+        size_t header_len = 2;
+        if (payload_len == 126) {
+            if (len < begin + 4) {
+                return ParseStatus::InComplete;
+            }
+            payload_len = (static_cast<uint64_t>(header[2]) << 8) | header[3];
+            header_len = 4;
+        } else if (payload_len == 127) {
+            if (len < begin + 10) {
+                return ParseStatus::InComplete;
+            }
+            payload_len = 0;
+            for (size_t i = 2; i < 10; i++) {
+                payload_len = (payload_len << 8) | header[i];
+            }
+            // 64位长度的最高位必须为0
+            if (payload_len >> 63) {
+                return ParseStatus::Error;
+            }
+            header_len = 10;
+        }
+        header_len += 4;
+
+        if (opcode & 0x8) {
+            // 控制帧不能分片, 负载不超过125字节
+            if (!fin || payload_len > 125 || (opcode != 0x8 && opcode != 0x9 && opcode != 0xa)) {
+                return ParseStatus::Error;
+            }
+        } else {
+            if (opcode > 0x2 || (opcode == 0x0) != in_fragment_) {
+                return ParseStatus::Error;
+            }
+            if (max_message_len_ != 0 && payload_len > max_message_len_ - message_len_) {
+                return ParseStatus::Error;
+            }
+        }
+        if (payload_len > static_cast<size_t>(-1) - begin - header_len) {
+            return ParseStatus::Error;
+        }
+        if (len - begin - header_len < payload_len) {
+            return ParseStatus::InComplete;
+        }
+
+        // 整帧到达后才去掩码, 保证每个字节只异或一次
+        char* payload = data + begin + header_len;
+        Unmask(payload, payload_len, data + begin + header_len - 4);
+        size_t frame_end = begin + header_len + payload_len;
+
+        if (opcode & 0x8) {
+            message_.opcode_ = static_cast<WebSocketMessage::Opcode>(opcode);
+            message_.payload_ = MessageView(payload, payload_len);
+            message_.close_code_ = 0;
+            if (opcode == 0x8) {
+                // Close帧负载为空或以2字节状态码开头
+                if (payload_len == 1) {
+                    return ParseStatus::Error;
+                }
+                if (payload_len >= 2) {
+                    message_.close_code_ = (static_cast<uint16_t>(static_cast<unsigned char>(payload[0])) << 8) | static_cast<unsigned char>(payload[1]);
+                    if (message_.close_code_ < 1000) {
+                        return ParseStatus::Error;
+                    }
+                }
+            }
+            frame_begin_ = begin;
+            frame_end_ = frame_end;
+            return ParseStatus::Control;
+        }
+
+        if (!in_fragment_) {
+            message_opcode_ = static_cast<WebSocketMessage::Opcode>(opcode);
+        }
+        if (payload_len > 0 || segments_.empty()) {
+            Range range = {begin + header_len, static_cast<size_t>(payload_len)};
+            segments_.push_back(range);
+        }
+        message_len_ += payload_len;
+        next_frame_ = frame_end;
+        if (!fin) {
+            in_fragment_ = true;
+            continue;
+        }
+
+        message_.opcode_ = message_opcode_;
+        message_.payload_ = MessageView();
+        message_.close_code_ = 0;
+        for (size_t i = 0; i < segments_.size(); i++) {
+            if (i == 0) {
+                message_.payload_ = MessageView(data + segments_[i].begin_, segments_[i].len_);
+            } else {
+                message_.payload_.AppendSegment(data + segments_[i].begin_, segments_[i].len_);
+            }
+        }
+        frame_begin_ = 0;
+        frame_end_ = frame_end;
+        message_done_ = true;
+        return ParseStatus::Complete;
+    }
+}
+
+size_t WebSocketParser::GetFrameBegin() const
+{
+    return frame_begin_;
+}
+
+size_t WebSocketParser::GetFrameEnd() const
+{
+    return frame_end_;
+}
+
+const WebSocketMessage& WebSocketParser::GetMessage() const
+{
+    return message_;
+}
+
+WebSocketParser* WebSocketParser::SetMaxMessageLen(size_t max_message_len)
+{
+    max_message_len_ = max_message_len;
+
+    return this;
+}
+
+void WebSocketParser::Reset()
+{
+    next_frame_ = 0;
+    in_fragment_ = false;
+    message_done_ = false;
+    message_opcode_ = WebSocketMessage::Opcode::Text;
+    message_len_ = 0;
+    segments_.clear();
+    frame_begin_ = 0;
+    frame_end_ = 0;
+}
+
+void WebSocketParser::Unmask(char* data, size_t len, const char* mask)
+{
+    static const UnmaskFunc unmask_func = SelectUnmask();
+
+    unmask_func(data, len, mask);
+}
+
+size_t WebSocketParser::EncodeHeader(char* header, WebSocketMessage::Opcode opcode, size_t payload_len, bool fin)
+{
+    header[0] = static_cast<char>((fin ? 0x80 : 0x00) | static_cast<unsigned char>(opcode));
+    if (payload_len < 126) {
+        header[1] = static_cast<char>(payload_len);
+        return 2;
+    }
+    if (payload_len <= 0xffff) {
+        header[1] = 126;
+        header[2] = static_cast<char>(payload_len >> 8);
+        header[3] = static_cast<char>(payload_len);
+        return 4;
+    }
+    header[1] = 127;
+    uint64_t len = payload_len;
+    for (size_t i = 9; i >= 2; i--) {
+        header[i] = static_cast<char>(len & 0xff);
+        len >>= 8;
+    }
+
+    return 10;
+}
+
+WebSocketParser::UnmaskFunc WebSocketParser::SelectUnmask()
+{
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        return &WebSocketParser::UnmaskAvx2;
+    }
+    if (__builtin_cpu_supports("sse2")) {
+        return &WebSocketParser::UnmaskSse2;
+    }
+#endif
+
+    return &WebSocketParser::UnmaskScalar;
+}
+
+void WebSocketParser::UnmaskScalar(char* data, size_t len, const char* mask)
+{
+    // 按8字节处理, 掩码以4字节为周期, 每次处理的起点都是4的倍数
+    uint64_t key;
+    memcpy(&key, mask, 4);
+    memcpy(reinterpret_cast<char*>(&key) + 4, mask, 4);
+    size_t idx = 0;
+    for (; idx + 8 <= len; idx += 8) {
+        uint64_t word;
+        memcpy(&word, data + idx, 8);
+        word ^= key;
+        memcpy(data + idx, &word, 8);
+    }
+    for (; idx < len; idx++) {
+        data[idx] ^= mask[idx & 3];
+    }
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+
+__attribute__((target("sse2")))
+void WebSocketParser::UnmaskSse2(char* data, size_t len, const char* mask)
+{
+    int32_t key;
+    memcpy(&key, mask, 4);
+    const __m128i keys = _mm_set1_epi32(key);
+    size_t idx = 0;
+    for (; idx + 16 <= len; idx += 16) {
+        __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + idx));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(data + idx), _mm_xor_si128(block, keys));
+    }
+
+    UnmaskScalar(data + idx, len - idx, mask);
+}
+
+__attribute__((target("avx2")))
+void WebSocketParser::UnmaskAvx2(char* data, size_t len, const char* mask)
+{
+    int32_t key;
+    memcpy(&key, mask, 4);
+    const __m256i keys = _mm256_set1_epi32(key);
+    size_t idx = 0;
+    for (; idx + 64 <= len; idx += 64) {
+        __m256i block0 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + idx));
+        __m256i block1 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + idx + 32));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(data + idx), _mm256_xor_si256(block0, keys));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(data + idx + 32), _mm256_xor_si256(block1, keys));
+    }
+    for (; idx + 32 <= len; idx += 32) {
+        __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + idx));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(data + idx), _mm256_xor_si256(block, keys));
+    }
+
+    UnmaskScalar(data + idx, len - idx, mask);
+}
+
+#endif
+
+} // namespace Imagine_Muduo